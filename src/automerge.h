@@ -25,6 +25,8 @@
 typedef struct {
     AMresult *result;  // Owns the document (freed in finalizer)
     AMdoc *doc;        // Borrowed pointer extracted from result
+    struct am_graph *graph;  // Change graph index (graph.c), built on first use
+    AMresult *diff_cursor;   // Heads at the last am_patches_since_last() (diff.c)
 } am_doc;
 
 // Sync state wrapper (owns AMresult, state pointer is borrowed)
@@ -40,6 +42,7 @@ SEXP C_am_create(SEXP actor_id);
 SEXP C_am_save(SEXP doc_ptr);
 SEXP C_am_load(SEXP data);
 SEXP C_am_fork(SEXP doc_ptr, SEXP heads);
+SEXP C_am_save_since(SEXP doc_ptr, SEXP heads);
 SEXP C_am_merge(SEXP doc_ptr, SEXP other_ptr);
 SEXP C_am_get_actor(SEXP doc_ptr);
 SEXP C_am_get_actor_hex(SEXP doc_ptr);
@@ -50,31 +53,84 @@ SEXP C_am_get_last_local_change(SEXP doc_ptr);
 SEXP C_am_get_change_by_hash(SEXP doc_ptr, SEXP hash);
 SEXP C_am_get_changes_added(SEXP doc1_ptr, SEXP doc2_ptr);
 
+// Parallel batch operations (parallel.c)
+SEXP C_am_load_many(SEXP data, SEXP threads);
+SEXP C_am_save_many(SEXP docs, SEXP threads);
+
+// Pack files (pack.c)
+SEXP C_am_pack_write(SEXP path, SEXP ids, SEXP payloads, SEXP heads, SEXP append,
+                     SEXP tmp_path);
+SEXP C_am_pack_read(SEXP path, SEXP id);
+SEXP C_am_pack_index(SEXP path);
+SEXP C_am_pack_compact(SEXP path, SEXP tmp_path);
+
+// Document cache (cache.c)
+SEXP C_am_cache_new(SEXP max_bytes);
+SEXP C_am_cache_get(SEXP cache_ptr, SEXP key);
+SEXP C_am_cache_put(SEXP cache_ptr, SEXP key, SEXP data);
+SEXP C_am_cache_stats(SEXP cache_ptr);
+
 // Object operations (objects.c)
 SEXP C_am_put(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos, SEXP value);
-SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos);
+SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos, SEXP heads);
 SEXP C_am_delete(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos);
-SEXP C_am_keys(SEXP doc_ptr, SEXP obj_ptr);
-SEXP C_am_length(SEXP doc_ptr, SEXP obj_ptr);
+SEXP C_am_keys(SEXP doc_ptr, SEXP obj_ptr, SEXP heads);
+SEXP C_am_length(SEXP doc_ptr, SEXP obj_ptr, SEXP heads);
 SEXP C_am_insert(SEXP doc_ptr, SEXP obj_ptr, SEXP pos, SEXP value);
 SEXP C_am_text_splice(SEXP text_ptr, SEXP pos, SEXP del_count, SEXP text);
-SEXP C_am_text_get(SEXP text_ptr);
-SEXP C_am_values(SEXP doc_ptr, SEXP obj_ptr);
+SEXP C_am_text_get(SEXP text_ptr, SEXP heads);
+SEXP C_am_values(SEXP doc_ptr, SEXP obj_ptr, SEXP heads);
 SEXP C_am_counter_increment(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos, SEXP delta);
 
 // Synchronization operations (sync.c)
 SEXP C_am_sync_state_new(void);
+SEXP C_am_sync_state_save(SEXP sync_state_ptr);
+SEXP C_am_sync_state_load(SEXP data);
 SEXP C_am_sync_encode(SEXP doc_ptr, SEXP sync_state_ptr);
 SEXP C_am_sync_decode(SEXP doc_ptr, SEXP sync_state_ptr, SEXP message);
+SEXP C_am_sync_message_info(SEXP message);
+SEXP C_am_sync(SEXP doc1_ptr, SEXP doc2_ptr);
 SEXP C_am_get_heads(SEXP doc_ptr);
-SEXP C_am_get_changes(SEXP doc_ptr, SEXP heads);
+SEXP C_am_get_changes(SEXP doc_ptr, SEXP heads, SEXP buffer);
+SEXP C_am_changes_meta(SEXP doc_ptr, SEXP heads);
 SEXP C_am_apply_changes(SEXP doc_ptr, SEXP changes);
 
+// Multi-peer sync hub (hub.c)
+SEXP C_am_sync_hub_new(SEXP doc_ptr);
+SEXP C_am_sync_hub_receive(SEXP hub_ptr, SEXP peer, SEXP message);
+SEXP C_am_sync_hub_outbox(SEXP hub_ptr);
+SEXP C_am_sync_hub_peers(SEXP hub_ptr);
+SEXP C_am_sync_hub_remove(SEXP hub_ptr, SEXP peer);
+int am_heads_changed(AMdoc *doc, uint8_t **stored, size_t *stored_len);  // Also used by transport.c
+
+// Batched sync (batch.c)
+SEXP C_am_sync_batch_encode(SEXP docs, SEXP states);
+SEXP C_am_sync_batch_decode(SEXP docs, SEXP states, SEXP buffer);
+
+// Socket transport (transport.c)
+SEXP C_am_sync_listen(SEXP doc_ptr, SEXP url);
+SEXP C_am_sync_connect(SEXP doc_ptr, SEXP url);
+SEXP C_am_sync_poll(SEXP endpoint_ptr, SEXP timeout);
+SEXP C_am_sync_close(SEXP endpoint_ptr);
+SEXP C_am_sync_endpoint_info(SEXP endpoint_ptr);
+
+// Change graph queries (graph.c)
+SEXP C_am_is_ancestor(SEXP doc_ptr, SEXP a, SEXP b);
+SEXP C_am_common_ancestors(SEXP doc_ptr, SEXP a, SEXP b);
+SEXP C_am_changes_between(SEXP doc_ptr, SEXP from, SEXP to);
+SEXP C_am_blame(SEXP doc_ptr, SEXP obj_ptr);
+void am_graph_free(struct am_graph *graph);
+
+// Patches (diff.c)
+SEXP C_am_diff(SEXP doc_ptr, SEXP before, SEXP after);
+SEXP C_am_patches_since_last(SEXP doc_ptr);
+SEXP am_diff_heads(SEXP doc_ptr, AMitems const *before, AMitems const *after);
+
 // Cursor and mark operations (cursors.c)
 SEXP C_am_cursor(SEXP obj_ptr, SEXP position);
 SEXP C_am_cursor_position(SEXP cursor_ptr);
 SEXP C_am_mark_create(SEXP obj_ptr, SEXP start, SEXP end, SEXP name, SEXP value, SEXP expand);
-SEXP C_am_marks(SEXP obj_ptr);
+SEXP C_am_marks(SEXP obj_ptr, SEXP heads);
 SEXP C_am_marks_at(SEXP obj_ptr, SEXP position);
 
 // Finalizers (memory.c)
@@ -87,10 +143,18 @@ AMdoc *get_doc(SEXP doc_ptr);  // Returns borrowed AMdoc* pointer
 const AMobjId *get_objid(SEXP obj_ptr);
 SEXP get_doc_from_objid(SEXP obj_ptr);  // Extract doc from am_object protection chain
 SEXP C_get_doc_from_objid(SEXP obj_ptr);  // Exported for R .Call() interface
+SEXP am_wrap_doc(AMresult *result);  // Takes ownership of a checked AM_VAL_TYPE_DOC result
+uint64_t am_hash_bytes(const void *data, size_t len);  // FNV-1a, for string-keyed tables
+AMresult *am_heads_to_result(SEXP heads);  // NULL for NULL/empty; caller frees
+SEXP am_read_heads(SEXP heads, AMitems *items, AMitems const **at);
+SEXP C_am_heads_prepare(SEXP doc_ptr, SEXP heads);  // Exported for R .Call() interface
 SEXP wrap_am_result(AMresult *result, SEXP parent_doc_sexp);
 SEXP am_wrap_objid(const AMobjId *obj_id, SEXP parent_result_sexp);
 SEXP am_wrap_nested_object(const AMobjId *obj_id, SEXP parent_result_sexp);
 
+// Helper functions (objects.c)
+SEXP am_item_to_r(AMitem *item, SEXP parent_doc_sexp, SEXP parent_result_sexp);
+
 // Error handling (errors.c)
 void check_result_impl(AMresult *result, AMvalType expected_type,
                        const char *file, int line);
@@ -0,0 +1,321 @@
+#include "automerge.h"
+
+// Batched Sync ----------------------------------------------------------------
+//
+// Carries the sync messages for many documents in one buffer:
+//
+//   header "AMSB" | u32 n_frames                                    (8 bytes)
+//   frame  u32 id_length | u32 message_length | id | message
+//
+// All integers are little-endian. Documents and their sync states are
+// passed as two parallel lists; the names of the document list are the ids
+// written into (and matched against) the frames. Documents with nothing to
+// send do not get a frame, so an up-to-date pair of nodes exchanges only the
+// 8-byte header.
+
+#define BATCH_MAGIC "AMSB"
+#define BATCH_HEADER_SIZE 8
+#define BATCH_FRAME_HEADER_SIZE 8
+
+static void put_u32(uint8_t *buf, uint32_t x) {
+    for (int i = 0; i < 4; i++) buf[i] = (uint8_t) (x >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) x |= (uint32_t) buf[i] << (8 * i);
+    return x;
+}
+
+static am_syncstate *get_state(SEXP sync_state_ptr) {
+    if (TYPEOF(sync_state_ptr) != EXTPTRSXP) {
+        Rf_error("Expected external pointer for sync state");
+    }
+    am_syncstate *state_wrapper = (am_syncstate *) R_ExternalPtrAddr(sync_state_ptr);
+    if (!state_wrapper || !state_wrapper->state) {
+        Rf_error("Invalid sync state pointer (NULL or freed)");
+    }
+    return state_wrapper;
+}
+
+// Validate the parallel docs/states lists and return the document ids
+static SEXP check_batch(SEXP docs, SEXP states) {
+    if (TYPEOF(docs) != VECSXP) {
+        Rf_error("docs must be a named list of Automerge documents");
+    }
+    if (TYPEOF(states) != VECSXP || XLENGTH(states) != XLENGTH(docs)) {
+        Rf_error("states must be a list of sync states, one per document");
+    }
+    SEXP ids = Rf_getAttrib(docs, R_NamesSymbol);
+    if (XLENGTH(docs) > 0 && TYPEOF(ids) != STRSXP) {
+        Rf_error("docs must be a named list of Automerge documents");
+    }
+    for (R_xlen_t i = 0; i < XLENGTH(docs); i++) {
+        SEXP id = STRING_ELT(ids, i);
+        if (id == NA_STRING || LENGTH(id) == 0) {
+            Rf_error("docs must have a non-empty name for every document");
+        }
+    }
+    return ids;
+}
+
+// Encoded messages of a batch, held until they are copied into the output
+typedef struct {
+    R_xlen_t n;
+    am_syncstate **states;
+    AMresult **encoded;        // NULL for documents without a message
+    SEXP ids;
+    size_t size;
+    uint32_t n_frames;
+    int done;                  // Set once the output buffer is complete
+} batch_ctx;
+
+/**
+ * Reset a sync state whose generated message will never be delivered.
+ *
+ * Generating a message records its changes as sent, so the state would
+ * otherwise wait for an acknowledgement that cannot come. Only the shared
+ * heads are kept (as by am_sync_state_save()), as after a reconnection, so
+ * the next message starts the exchange again. Falls back to a new state.
+ */
+static void reset_state(am_syncstate *w) {
+    AMresult *fresh = NULL;
+    AMresult *saved = AMsyncStateEncode(w->state);
+    if (AMresultStatus(saved) == AM_STATUS_OK) {
+        AMbyteSpan bytes;
+        AMitemToBytes(AMresultItem(saved), &bytes);
+        fresh = AMsyncStateDecode(bytes.src, bytes.count);
+    }
+    AMresultFree(saved);
+    if (!fresh || AMresultStatus(fresh) != AM_STATUS_OK) {
+        if (fresh) AMresultFree(fresh);
+        fresh = AMsyncStateInit();
+        if (AMresultStatus(fresh) != AM_STATUS_OK) {
+            AMresultFree(fresh);
+            return;
+        }
+    }
+    AMsyncState *state = NULL;
+    AMitemToSyncState(AMresultItem(fresh), &state);
+    AMresultFree(w->result);
+    w->result = fresh;
+    w->state = state;
+}
+
+// Free the held messages, resetting their states unless they were delivered
+static void batch_release(void *data) {
+    batch_ctx *ctx = (batch_ctx *) data;
+    for (R_xlen_t i = 0; i < ctx->n; i++) {
+        if (!ctx->encoded[i]) continue;
+        if (!ctx->done) reset_state(ctx->states[i]);
+        AMresultFree(ctx->encoded[i]);
+        ctx->encoded[i] = NULL;
+    }
+}
+
+// Copy the held messages into a new framed buffer
+static SEXP batch_build(void *data) {
+    batch_ctx *ctx = (batch_ctx *) data;
+    SEXP out = Rf_allocVector(RAWSXP, (R_xlen_t) ctx->size);
+    uint8_t *frame = RAW(out);
+    memcpy(frame, BATCH_MAGIC, 4);
+    put_u32(frame + 4, ctx->n_frames);
+    frame += BATCH_HEADER_SIZE;
+
+    for (R_xlen_t i = 0; i < ctx->n; i++) {
+        if (!ctx->encoded[i]) continue;
+        AMbyteSpan bytes;
+        AMitemToBytes(AMresultItem(ctx->encoded[i]), &bytes);
+        SEXP id = STRING_ELT(ctx->ids, i);
+        size_t id_len = (size_t) LENGTH(id);
+
+        put_u32(frame, (uint32_t) id_len);
+        put_u32(frame + 4, (uint32_t) bytes.count);
+        memcpy(frame + BATCH_FRAME_HEADER_SIZE, CHAR(id), id_len);
+        memcpy(frame + BATCH_FRAME_HEADER_SIZE + id_len, bytes.src, bytes.count);
+        frame += BATCH_FRAME_HEADER_SIZE + id_len + bytes.count;
+    }
+    ctx->done = 1;
+    return out;
+}
+
+/**
+ * Generate the sync messages for a batch of documents as one buffer.
+ *
+ * Each message is generated and encoded before moving on to the next, and
+ * held until all of them are copied into the output. If any step fails, the
+ * states of the documents whose messages were generated are reset (see
+ * reset_state()), since the batch carrying those messages is never returned.
+ *
+ * @param docs Named list of external pointers to am_doc
+ * @param states List of external pointers to am_syncstate, parallel to docs
+ * @return Raw vector containing the framed batch, or NULL if no document
+ *   has a message to send
+ */
+SEXP C_am_sync_batch_encode(SEXP docs, SEXP states) {
+    SEXP ids = check_batch(docs, states);
+    R_xlen_t n = XLENGTH(docs);
+
+    // Resolve every document and state before any of them is touched
+    AMdoc **doc = (AMdoc **) R_alloc(n > 0 ? n : 1, sizeof(AMdoc *));
+    batch_ctx ctx = {n, NULL, NULL, ids, BATCH_HEADER_SIZE, 0, 0};
+    ctx.states = (am_syncstate **) R_alloc(n > 0 ? n : 1, sizeof(am_syncstate *));
+    ctx.encoded = (AMresult **) R_alloc(n > 0 ? n : 1, sizeof(AMresult *));
+    for (R_xlen_t i = 0; i < n; i++) {
+        doc[i] = get_doc(VECTOR_ELT(docs, i));
+        ctx.states[i] = get_state(VECTOR_ELT(states, i));
+        ctx.encoded[i] = NULL;
+    }
+
+    char error_msg[MAX_ERROR_MSG_SIZE + 1];
+    for (R_xlen_t i = 0; i < n; i++) {
+        AMresult *result = AMgenerateSyncMessage(doc[i], ctx.states[i]->state);
+        if (AMresultStatus(result) != AM_STATUS_OK) {
+            AMbyteSpan err = AMresultError(result);
+            snprintf(error_msg, sizeof(error_msg), "%.*s", (int) err.count, (const char *) err.src);
+            AMresultFree(result);
+            batch_release(&ctx);
+            Rf_error("Failed to generate sync message for '%s': %s",
+                     CHAR(STRING_ELT(ids, i)), error_msg);
+        }
+        AMitem *item = AMresultItem(result);
+        if (!item || AMitemValType(item) != AM_VAL_TYPE_SYNC_MESSAGE) {
+            AMresultFree(result);
+            continue;
+        }
+
+        AMsyncMessage const *msg = NULL;
+        AMitemToSyncMessage(item, &msg);
+        AMresult *encoded = AMsyncMessageEncode(msg);
+        AMresultFree(result);
+        if (AMresultStatus(encoded) != AM_STATUS_OK) {
+            AMbyteSpan err = AMresultError(encoded);
+            snprintf(error_msg, sizeof(error_msg), "%.*s", (int) err.count, (const char *) err.src);
+            AMresultFree(encoded);
+            reset_state(ctx.states[i]);
+            batch_release(&ctx);
+            Rf_error("Failed to encode sync message for '%s': %s",
+                     CHAR(STRING_ELT(ids, i)), error_msg);
+        }
+        ctx.encoded[i] = encoded;
+
+        AMbyteSpan bytes;
+        AMitemToBytes(AMresultItem(encoded), &bytes);
+        size_t frame_size = BATCH_FRAME_HEADER_SIZE + (size_t) LENGTH(STRING_ELT(ids, i)) +
+                            bytes.count;
+        if (bytes.count > UINT32_MAX || ctx.n_frames == UINT32_MAX ||
+            ctx.size + frame_size > (size_t) R_XLEN_T_MAX) {
+            batch_release(&ctx);
+            Rf_error("Sync batch is too large");
+        }
+        ctx.size += frame_size;
+        ctx.n_frames++;
+    }
+
+    if (ctx.n_frames == 0) {
+        return R_NilValue;
+    }
+
+    // The output is the only R allocation made while messages are held, so
+    // it runs with a cleanup that frees them either way
+    return R_ExecWithCleanup(batch_build, &ctx, batch_release, &ctx);
+}
+
+/**
+ * Apply a framed batch of sync messages to the matching documents.
+ *
+ * Frames are matched to documents by id through an open-addressing table
+ * over names(docs), so a batch costs O(documents + frames).
+ *
+ * @param docs Named list of external pointers to am_doc
+ * @param states List of external pointers to am_syncstate, parallel to docs
+ * @param buffer Raw vector produced by C_am_sync_batch_encode
+ * @return Character vector of the ids that received a message
+ */
+SEXP C_am_sync_batch_decode(SEXP docs, SEXP states, SEXP buffer) {
+    SEXP ids = check_batch(docs, states);
+    R_xlen_t n = XLENGTH(docs);
+    if (TYPEOF(buffer) != RAWSXP) {
+        Rf_error("buffer must be a raw vector");
+    }
+
+    const uint8_t *p = RAW(buffer);
+    size_t remaining = (size_t) XLENGTH(buffer);
+    if (remaining < BATCH_HEADER_SIZE || memcmp(p, BATCH_MAGIC, 4) != 0) {
+        Rf_error("Invalid sync batch: missing header");
+    }
+    uint32_t n_frames = get_u32(p + 4);
+    p += BATCH_HEADER_SIZE;
+    remaining -= BATCH_HEADER_SIZE;
+    if (n_frames > remaining / BATCH_FRAME_HEADER_SIZE) {
+        Rf_error("Invalid sync batch: unexpected end of input");
+    }
+
+    size_t n_slots = 16;
+    while (n_slots < 2 * (size_t) n) n_slots *= 2;
+    R_xlen_t *slots = (R_xlen_t *) R_alloc(n_slots, sizeof(R_xlen_t));
+    for (size_t s = 0; s < n_slots; s++) slots[s] = -1;
+    for (R_xlen_t i = 0; i < n; i++) {
+        SEXP id = STRING_ELT(ids, i);
+        size_t s = am_hash_bytes(CHAR(id), LENGTH(id)) & (n_slots - 1);
+        while (slots[s] >= 0) {
+            SEXP other = STRING_ELT(ids, slots[s]);
+            if (LENGTH(other) == LENGTH(id) && memcmp(CHAR(other), CHAR(id), LENGTH(id)) == 0) {
+                Rf_error("docs must have unique names");
+            }
+            s = (s + 1) & (n_slots - 1);
+        }
+        slots[s] = i;
+    }
+
+    SEXP received = PROTECT(Rf_allocVector(STRSXP, n_frames));
+    for (uint32_t f = 0; f < n_frames; f++) {
+        if (remaining < BATCH_FRAME_HEADER_SIZE) {
+            Rf_error("Invalid sync batch: unexpected end of input");
+        }
+        size_t id_len = get_u32(p);
+        size_t msg_len = get_u32(p + 4);
+        p += BATCH_FRAME_HEADER_SIZE;
+        remaining -= BATCH_FRAME_HEADER_SIZE;
+        if (id_len > remaining || msg_len > remaining - id_len) {
+            Rf_error("Invalid sync batch: unexpected end of input");
+        }
+        const char *id = (const char *) p;
+        const uint8_t *message = p + id_len;
+        p += id_len + msg_len;
+        remaining -= id_len + msg_len;
+
+        R_xlen_t match = -1;
+        size_t s = am_hash_bytes(id, id_len) & (n_slots - 1);
+        for (; slots[s] >= 0; s = (s + 1) & (n_slots - 1)) {
+            SEXP candidate = STRING_ELT(ids, slots[s]);
+            if ((size_t) LENGTH(candidate) == id_len &&
+                memcmp(CHAR(candidate), id, id_len) == 0) {
+                match = slots[s];
+                break;
+            }
+        }
+        if (match < 0) {
+            Rf_error("Sync batch contains a message for unknown document '%.*s'",
+                     (int) id_len, id);
+        }
+
+        AMdoc *doc = get_doc(VECTOR_ELT(docs, match));
+        AMsyncState *state = get_state(VECTOR_ELT(states, match))->state;
+
+        AMresult *decode_result = AMsyncMessageDecode(message, msg_len);
+        CHECK_RESULT(decode_result, AM_VAL_TYPE_SYNC_MESSAGE);
+        AMsyncMessage const *msg = NULL;
+        AMitemToSyncMessage(AMresultItem(decode_result), &msg);
+
+        AMresult *result = AMreceiveSyncMessage(doc, state, msg);
+        AMresultFree(decode_result);
+        CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+        AMresultFree(result);
+
+        SET_STRING_ELT(received, f, STRING_ELT(ids, match));
+    }
+
+    UNPROTECT(1);
+    return received;
+}
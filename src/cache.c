@@ -0,0 +1,284 @@
+#include "automerge.h"
+
+// Document Cache --------------------------------------------------------------
+//
+// A bounded LRU cache of decoded documents, keyed by string. Entries live in
+// a chained hash table for lookup and a doubly linked list for recency (most
+// recent at the head). The cost of an entry is the size of the serialized
+// document it was loaded from; entries are evicted from the tail until the
+// total is within max_bytes.
+//
+// Callers never receive the cached AMdoc itself: a hit returns an AMfork()
+// of it, so edits to the returned document cannot alter the cached copy.
+
+#define CACHE_INITIAL_BUCKETS 64
+
+typedef struct cache_entry {
+    char *key;
+    size_t key_len;
+    uint64_t hash;
+    AMresult *result;           // Owns the document
+    AMdoc *doc;                 // Borrowed from result
+    size_t bytes;               // Serialized size (cost)
+    struct cache_entry *prev;   // LRU list
+    struct cache_entry *next;
+    struct cache_entry *chain;  // Hash bucket chain
+} cache_entry;
+
+typedef struct {
+    cache_entry **buckets;
+    size_t n_buckets;
+    size_t n_entries;
+    size_t bytes;
+    size_t max_bytes;
+    cache_entry *head;
+    cache_entry *tail;
+    double hits;
+    double misses;
+    double evictions;
+} am_cache;
+
+static void lru_unlink(am_cache *cache, cache_entry *e) {
+    if (e->prev) e->prev->next = e->next; else cache->head = e->next;
+    if (e->next) e->next->prev = e->prev; else cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push_front(am_cache *cache, cache_entry *e) {
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head) cache->head->prev = e;
+    cache->head = e;
+    if (!cache->tail) cache->tail = e;
+}
+
+static cache_entry *cache_find(am_cache *cache, const char *key, size_t len, uint64_t hash) {
+    cache_entry *e = cache->buckets[hash & (cache->n_buckets - 1)];
+    for (; e; e = e->chain) {
+        if (e->hash == hash && e->key_len == len && memcmp(e->key, key, len) == 0) return e;
+    }
+    return NULL;
+}
+
+static void entry_free(cache_entry *e) {
+    AMresultFree(e->result);
+    free(e->key);
+    free(e);
+}
+
+// Unlink an entry from both structures and free it
+static void cache_remove(am_cache *cache, cache_entry *e) {
+    cache_entry **slot = &cache->buckets[e->hash & (cache->n_buckets - 1)];
+    while (*slot != e) slot = &(*slot)->chain;
+    *slot = e->chain;
+    lru_unlink(cache, e);
+    cache->n_entries--;
+    cache->bytes -= e->bytes;
+    entry_free(e);
+}
+
+// Double the bucket array once the load factor exceeds 1 (best effort)
+static void cache_grow(am_cache *cache) {
+    size_t n = cache->n_buckets * 2;
+    cache_entry **buckets = calloc(n, sizeof(cache_entry *));
+    if (!buckets) return;
+    for (size_t i = 0; i < cache->n_buckets; i++) {
+        cache_entry *e = cache->buckets[i];
+        while (e) {
+            cache_entry *next = e->chain;
+            e->chain = buckets[e->hash & (n - 1)];
+            buckets[e->hash & (n - 1)] = e;
+            e = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->n_buckets = n;
+}
+
+static void am_cache_finalizer(SEXP ext_ptr) {
+    am_cache *cache = (am_cache *) R_ExternalPtrAddr(ext_ptr);
+    if (cache) {
+        cache_entry *e = cache->head;
+        while (e) {
+            cache_entry *next = e->next;
+            entry_free(e);
+            e = next;
+        }
+        free(cache->buckets);
+        free(cache);
+    }
+    R_ClearExternalPtr(ext_ptr);
+}
+
+static am_cache *get_cache(SEXP cache_ptr) {
+    if (TYPEOF(cache_ptr) != EXTPTRSXP || !Rf_inherits(cache_ptr, "am_cache")) {
+        Rf_error("Expected an am_cache object");
+    }
+    am_cache *cache = (am_cache *) R_ExternalPtrAddr(cache_ptr);
+    if (!cache) {
+        Rf_error("Invalid cache pointer (NULL or freed)");
+    }
+    return cache;
+}
+
+static const char *get_key(SEXP key, size_t *len) {
+    if (TYPEOF(key) != STRSXP || XLENGTH(key) != 1 || STRING_ELT(key, 0) == NA_STRING) {
+        Rf_error("key must be a single character string");
+    }
+    *len = (size_t) LENGTH(STRING_ELT(key, 0));
+    return CHAR(STRING_ELT(key, 0));
+}
+
+static SEXP fork_doc(AMdoc *doc) {
+    AMresult *result = AMfork(doc, NULL);
+    CHECK_RESULT(result, AM_VAL_TYPE_DOC);
+    return am_wrap_doc(result);
+}
+
+/**
+ * Create a new document cache.
+ *
+ * @param max_bytes Numeric scalar: budget in serialized bytes
+ * @return External pointer with class "am_cache"
+ */
+SEXP C_am_cache_new(SEXP max_bytes) {
+    if ((TYPEOF(max_bytes) != REALSXP && TYPEOF(max_bytes) != INTSXP) ||
+        XLENGTH(max_bytes) != 1) {
+        Rf_error("max_bytes must be a single non-negative number");
+    }
+    double max = Rf_asReal(max_bytes);
+    if (ISNAN(max) || max < 0) {
+        Rf_error("max_bytes must be a single non-negative number");
+    }
+
+    am_cache *cache = calloc(1, sizeof(am_cache));
+    cache_entry **buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(cache_entry *));
+    if (!cache || !buckets) {
+        free(cache);
+        free(buckets);
+        Rf_error("Failed to allocate memory for document cache");
+    }
+    cache->buckets = buckets;
+    cache->n_buckets = CACHE_INITIAL_BUCKETS;
+    cache->max_bytes = max >= (double) SIZE_MAX ? SIZE_MAX : (size_t) max;
+
+    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(cache, R_NilValue, R_NilValue));
+    R_RegisterCFinalizer(ext_ptr, am_cache_finalizer);
+    Rf_classgets(ext_ptr, Rf_mkString("am_cache"));
+
+    UNPROTECT(1);
+    return ext_ptr;
+}
+
+/**
+ * Look up a document, counting a hit or a miss.
+ *
+ * @param cache_ptr External pointer to am_cache
+ * @param key Character string
+ * @return A fork of the cached document, or NULL on a miss
+ */
+SEXP C_am_cache_get(SEXP cache_ptr, SEXP key) {
+    am_cache *cache = get_cache(cache_ptr);
+    size_t len;
+    const char *k = get_key(key, &len);
+
+    cache_entry *e = cache_find(cache, k, len, am_hash_bytes(k, len));
+    if (!e) {
+        cache->misses++;
+        return R_NilValue;
+    }
+
+    cache->hits++;
+    lru_unlink(cache, e);
+    lru_push_front(cache, e);
+    return fork_doc(e->doc);
+}
+
+/**
+ * Load a document from bytes and insert it into the cache.
+ *
+ * An existing entry with the same key is replaced. A document larger than
+ * the whole budget is loaded and returned but not cached.
+ *
+ * @param cache_ptr External pointer to am_cache
+ * @param key Character string
+ * @param data Raw vector containing a serialized document
+ * @return A fork of the newly cached document (or the document itself if
+ *   it was too large to cache)
+ */
+SEXP C_am_cache_put(SEXP cache_ptr, SEXP key, SEXP data) {
+    am_cache *cache = get_cache(cache_ptr);
+    size_t len;
+    const char *k = get_key(key, &len);
+    if (TYPEOF(data) != RAWSXP) {
+        Rf_error("data must be a raw vector");
+    }
+
+    AMresult *result = AMload(RAW(data), (size_t) XLENGTH(data));
+    CHECK_RESULT(result, AM_VAL_TYPE_DOC);
+
+    size_t bytes = (size_t) XLENGTH(data);
+    if (bytes > cache->max_bytes) {
+        return am_wrap_doc(result);
+    }
+
+    cache_entry *e = calloc(1, sizeof(cache_entry));
+    char *key_copy = malloc(len + 1);
+    if (!e || !key_copy) {
+        free(e);
+        free(key_copy);
+        AMresultFree(result);
+        Rf_error("Failed to allocate memory for cache entry");
+    }
+    memcpy(key_copy, k, len);
+    key_copy[len] = '\0';
+
+    uint64_t hash = am_hash_bytes(k, len);
+    cache_entry *old = cache_find(cache, k, len, hash);
+    if (old) cache_remove(cache, old);
+
+    while (cache->tail && cache->bytes + bytes > cache->max_bytes) {
+        cache_remove(cache, cache->tail);
+        cache->evictions++;
+    }
+
+    e->key = key_copy;
+    e->key_len = len;
+    e->hash = hash;
+    e->result = result;
+    AMitemToDoc(AMresultItem(result), &e->doc);
+    e->bytes = bytes;
+
+    size_t slot = hash & (cache->n_buckets - 1);
+    e->chain = cache->buckets[slot];
+    cache->buckets[slot] = e;
+    lru_push_front(cache, e);
+    cache->n_entries++;
+    cache->bytes += bytes;
+    if (cache->n_entries > cache->n_buckets) cache_grow(cache);
+
+    return fork_doc(e->doc);
+}
+
+/**
+ * Cache counters.
+ *
+ * @param cache_ptr External pointer to am_cache
+ * @return Named list: hits, misses, evictions, entries, bytes, max_bytes
+ */
+SEXP C_am_cache_stats(SEXP cache_ptr) {
+    am_cache *cache = get_cache(cache_ptr);
+
+    const char *names[] = {"hits", "misses", "evictions", "entries", "bytes", "max_bytes", ""};
+    SEXP out = PROTECT(Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(out, 0, Rf_ScalarReal(cache->hits));
+    SET_VECTOR_ELT(out, 1, Rf_ScalarReal(cache->misses));
+    SET_VECTOR_ELT(out, 2, Rf_ScalarReal(cache->evictions));
+    SET_VECTOR_ELT(out, 3, Rf_ScalarReal((double) cache->n_entries));
+    SET_VECTOR_ELT(out, 4, Rf_ScalarReal((double) cache->bytes));
+    SET_VECTOR_ELT(out, 5, Rf_ScalarReal((double) cache->max_bytes));
+
+    UNPROTECT(1);
+    return out;
+}
@@ -138,16 +138,20 @@ static SEXP convert_mark_to_r_list(AMmark const *mark, size_t index) {
  * @param obj_ptr External pointer to AMobjId (must be text object)
  * @param filter_position If >= 0, filter marks to include only those at this position.
  *                        If < 0, return all marks (no filtering).
+ * @param heads NULL for the current state, or a list of change hashes
  * @return R list of marks
  */
-static SEXP C_am_marks_impl(SEXP obj_ptr, int filter_position) {
+static SEXP C_am_marks_impl(SEXP obj_ptr, int filter_position, SEXP heads) {
     SEXP doc_ptr = get_doc_from_objid(obj_ptr);
     AMdoc *doc = get_doc(doc_ptr);
 
     const AMobjId *obj_id = get_objid(obj_ptr);
 
-    // heads parameter NULL for current state
-    AMresult *result = AMmarks(doc, obj_id, NULL);
+    AMitems heads_items;
+    AMitems const *at;
+    PROTECT(am_read_heads(heads, &heads_items, &at));
+
+    AMresult *result = AMmarks(doc, obj_id, at);
     CHECK_RESULT(result, AM_VAL_TYPE_VOID);
 
     AMitems items = AMresultItems(result);
@@ -204,7 +208,7 @@ static SEXP C_am_marks_impl(SEXP obj_ptr, int filter_position) {
     }
 
     AMresultFree(result);
-    UNPROTECT(1);
+    UNPROTECT(2);
     return marks_list;
 }
 
@@ -440,13 +444,14 @@ SEXP C_am_mark_create(SEXP obj_ptr, SEXP start, SEXP end,
 /**
  * Get all marks in a text object.
  *
- * R signature: am_marks(obj)
+ * R signature: am_marks(obj, heads = NULL)
  *
  * @param obj_ptr External pointer to AMobjId (must be text object)
+ * @param heads NULL for the current state, or a list of change hashes
  * @return R list of marks, each mark is a list with: name, value, start, end
  */
-SEXP C_am_marks(SEXP obj_ptr) {
-    return C_am_marks_impl(obj_ptr, -1);  // -1 = no filtering
+SEXP C_am_marks(SEXP obj_ptr, SEXP heads) {
+    return C_am_marks_impl(obj_ptr, -1, heads);  // -1 = no filtering
 }
 
 /**
@@ -470,5 +475,5 @@ SEXP C_am_marks_at(SEXP obj_ptr, SEXP position) {
         Rf_error("position must be non-negative (uses 0-based indexing)");
     }
 
-    return C_am_marks_impl(obj_ptr, r_pos);
+    return C_am_marks_impl(obj_ptr, r_pos, R_NilValue);
 }
@@ -0,0 +1,491 @@
+#include "automerge.h"
+#include <stdint.h>
+
+// Patches ---------------------------------------------------------------------
+//
+// A diff walks the document from the root, reading every object as it was
+// at the "before" and the "after" heads, and records one patch row for each
+// difference. Values are compared by the id of the operation that set them,
+// so an unchanged value is recognised without comparing its contents and
+// list elements keep their identity when other elements are inserted or
+// deleted around them. Objects present at both points are descended into;
+// objects that are new at "after" are reported as a put (or insert) of the
+// object followed by patches building its contents.
+//
+// automerge-c exposes neither the operations of a change nor the parent of
+// an object, so there is no way to tell which subtrees the changes between
+// the two points touched: every object is read at both points, and a diff
+// is O(document) however small the edit. Only identical heads are skipped.
+//
+// Patch rows have the columns
+//
+//   path    list of keys (character) and 1-based indices (integer) leading
+//           from the root to the changed object
+//   action  "put", "insert", "delete", "splice" or "increment"
+//   key     map key, or NA
+//   index   1-based list index or text position, or NA
+//   value   new value, inserted text or counter delta (list column)
+//   length  elements or characters deleted, or characters spliced in, or NA
+
+#define PATCH_COLUMNS 6
+
+typedef struct {
+    SEXP cols;                 // VECSXP of PATCH_COLUMNS columns
+    PROTECT_INDEX ipx;
+    R_xlen_t n;
+} patch_log;
+
+typedef struct {
+    AMdoc *doc;
+    SEXP doc_ptr;
+    AMitems before;            // Heads read as "before" (if has_before)
+    AMitems after;             // Heads read as "after" (if has_after)
+    int has_before;            // 0: read the current state
+    int has_after;
+    int before_empty;          // 1: "before" is the empty document
+    int after_empty;
+    patch_log log;
+} diff_ctx;
+
+static void log_init(patch_log *log) {
+    static const SEXPTYPE types[PATCH_COLUMNS] = {VECSXP, STRSXP, STRSXP, INTSXP, VECSXP, INTSXP};
+    SEXP cols = Rf_allocVector(VECSXP, PATCH_COLUMNS);
+    PROTECT_WITH_INDEX(cols, &log->ipx);
+    for (int j = 0; j < PATCH_COLUMNS; j++) {
+        SET_VECTOR_ELT(cols, j, Rf_allocVector(types[j], 16));
+    }
+    log->cols = cols;
+    log->n = 0;
+}
+
+static void log_add(patch_log *log, SEXP path, const char *action, SEXP key,
+                    int index, SEXP value, int length) {
+    PROTECT(value);
+    R_xlen_t cap = XLENGTH(VECTOR_ELT(log->cols, 0));
+    if (log->n == cap) {
+        SEXP cols = PROTECT(Rf_allocVector(VECSXP, PATCH_COLUMNS));
+        for (int j = 0; j < PATCH_COLUMNS; j++) {
+            SET_VECTOR_ELT(cols, j, Rf_xlengthgets(VECTOR_ELT(log->cols, j), 2 * cap));
+        }
+        REPROTECT(cols, log->ipx);
+        log->cols = cols;
+        UNPROTECT(1);
+    }
+    R_xlen_t i = log->n++;
+    SET_VECTOR_ELT(VECTOR_ELT(log->cols, 0), i, path);
+    SET_STRING_ELT(VECTOR_ELT(log->cols, 1), i, Rf_mkChar(action));
+    SET_STRING_ELT(VECTOR_ELT(log->cols, 2), i, key);
+    INTEGER(VECTOR_ELT(log->cols, 3))[i] = index;
+    SET_VECTOR_ELT(VECTOR_ELT(log->cols, 4), i, value);
+    INTEGER(VECTOR_ELT(log->cols, 5))[i] = length;
+    UNPROTECT(1);
+}
+
+// Shrink the columns to the rows written and return them as a data frame
+static SEXP log_finish(patch_log *log) {
+    static const char *names[] = {"path", "action", "key", "index", "value", "length", ""};
+    SEXP out = PROTECT(Rf_mkNamed(VECSXP, names));
+    for (int j = 0; j < PATCH_COLUMNS; j++) {
+        SET_VECTOR_ELT(out, j, Rf_xlengthgets(VECTOR_ELT(log->cols, j), log->n));
+    }
+    // Compact row names c(NA, -n), as used by data.frame(). They must be
+    // filled in before they are attached, as setting the attribute reads them.
+    SEXP row_names = PROTECT(Rf_allocVector(INTSXP, log->n > 0 ? 2 : 0));
+    if (log->n > 0) {
+        INTEGER(row_names)[0] = NA_INTEGER;
+        INTEGER(row_names)[1] = -(int) log->n;
+    }
+    Rf_setAttrib(out, R_RowNamesSymbol, row_names);
+    Rf_classgets(out, Rf_mkString("data.frame"));
+    UNPROTECT(2);
+    return out;
+}
+
+// Extend a path by one map key or 1-based list index
+static SEXP path_child(SEXP path, SEXP key, int index) {
+    R_xlen_t n = XLENGTH(path);
+    SEXP child = PROTECT(Rf_allocVector(VECSXP, n + 1));
+    for (R_xlen_t i = 0; i < n; i++) SET_VECTOR_ELT(child, i, VECTOR_ELT(path, i));
+    SET_VECTOR_ELT(child, n, key != NA_STRING ? Rf_ScalarString(key) : Rf_ScalarInteger(index));
+    UNPROTECT(1);
+    return child;
+}
+
+static int is_object(AMitem *item) {
+    return AMitemValType(item) == AM_VAL_TYPE_OBJ_TYPE;
+}
+
+static int same_id(AMitem *a, AMitem *b) {
+    AMobjId const *id_a = AMitemObjId(a);
+    AMobjId const *id_b = AMitemObjId(b);
+    return id_a && id_b && AMobjIdEqual(id_a, id_b);
+}
+
+static SEXP key_of(AMitem *item) {
+    AMbyteSpan key;
+    AMitemKey(item, &key);
+    return Rf_mkCharLenCE((const char *) key.src, (int) key.count, CE_UTF8);
+}
+
+// Read the items of a map or list at one side of the diff. Returns the
+// wrapped result (kept alive by R for any object handles taken from it), or
+// R_NilValue if that side is the empty document.
+static SEXP read_items(diff_ctx *ctx, const AMobjId *obj_id, AMobjType type,
+                       int after, AMitems *items) {
+    if (after ? ctx->after_empty : ctx->before_empty) return R_NilValue;
+    const AMitems *heads = after ? (ctx->has_after ? &ctx->after : NULL)
+                                 : (ctx->has_before ? &ctx->before : NULL);
+    AMresult *result = NULL;
+    if (type == AM_OBJ_TYPE_MAP) {
+        AMbyteSpan none = {NULL, 0};
+        result = AMmapRange(ctx->doc, obj_id, none, none, heads);
+    } else {
+        result = AMlistRange(ctx->doc, obj_id, 0, SIZE_MAX, heads);
+    }
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+    SEXP wrapped = wrap_am_result(result, ctx->doc_ptr);
+    *items = AMresultItems(result);
+    return wrapped;
+}
+
+static SEXP read_text(diff_ctx *ctx, const AMobjId *obj_id, int after, AMbyteSpan *text) {
+    text->src = NULL;
+    text->count = 0;
+    if (after ? ctx->after_empty : ctx->before_empty) return R_NilValue;
+    const AMitems *heads = after ? (ctx->has_after ? &ctx->after : NULL)
+                                 : (ctx->has_before ? &ctx->before : NULL);
+    AMresult *result = AMtext(ctx->doc, obj_id, heads);
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+    SEXP wrapped = wrap_am_result(result, ctx->doc_ptr);
+    AMitem *item = AMresultItem(result);
+    if (item) AMitemToStr(item, text);
+    return wrapped;
+}
+
+static size_t count_chars(const uint8_t *s, size_t n) {
+    size_t chars = 0;
+    for (size_t i = 0; i < n; i++) chars += (s[i] & 0xC0) != 0x80;
+    return chars;
+}
+
+static void diff_object(diff_ctx *ctx, const AMobjId *obj_id, SEXP path);
+static void build_object(diff_ctx *ctx, const AMobjId *obj_id, SEXP path);
+
+// Record a new value at key (maps) or index (lists) and, for an object,
+// the patches that build its contents
+static void emit_value(diff_ctx *ctx, SEXP path, const char *action, SEXP key,
+                       int index, AMitem *item, SEXP owner) {
+    log_add(&ctx->log, path, action, key, index,
+            am_item_to_r(item, ctx->doc_ptr, owner), NA_INTEGER);
+    if (is_object(item)) {
+        SEXP child = PROTECT(path_child(path, key, index));
+        build_object(ctx, AMitemObjId(item), child);
+        UNPROTECT(1);
+    }
+}
+
+// Compare a value that kept its identity: descend into objects and report
+// counter increments
+static void diff_same(diff_ctx *ctx, SEXP path, SEXP key, int index,
+                      AMitem *before, AMitem *after) {
+    if (is_object(after)) {
+        SEXP child = PROTECT(path_child(path, key, index));
+        diff_object(ctx, AMitemObjId(after), child);
+        UNPROTECT(1);
+    } else if (AMitemValType(after) == AM_VAL_TYPE_COUNTER &&
+               AMitemValType(before) == AM_VAL_TYPE_COUNTER) {
+        int64_t old_val, new_val;
+        AMitemToCounter(before, &old_val);
+        AMitemToCounter(after, &new_val);
+        if (new_val != old_val) {
+            log_add(&ctx->log, path, "increment", key, index,
+                    Rf_ScalarReal((double) (new_val - old_val)), NA_INTEGER);
+        }
+    }
+}
+
+static void diff_map(diff_ctx *ctx, const AMobjId *obj_id, SEXP path) {
+    AMitems before, after;
+    SEXP before_owner = PROTECT(read_items(ctx, obj_id, AM_OBJ_TYPE_MAP, 0, &before));
+    SEXP after_owner = PROTECT(read_items(ctx, obj_id, AM_OBJ_TYPE_MAP, 1, &after));
+    AMitem *b = before_owner != R_NilValue ? AMitemsNext(&before, 1) : NULL;
+    AMitem *a = after_owner != R_NilValue ? AMitemsNext(&after, 1) : NULL;
+
+    // Both sides are in key order, so merge them
+    while (b || a) {
+        int cmp;
+        if (!b) {
+            cmp = 1;
+        } else if (!a) {
+            cmp = -1;
+        } else {
+            AMbyteSpan kb, ka;
+            AMitemKey(b, &kb);
+            AMitemKey(a, &ka);
+            size_t n = kb.count < ka.count ? kb.count : ka.count;
+            cmp = memcmp(kb.src, ka.src, n);
+            if (cmp == 0) cmp = (kb.count > ka.count) - (kb.count < ka.count);
+        }
+
+        if (cmp < 0) {
+            SEXP key = PROTECT(key_of(b));
+            log_add(&ctx->log, path, "delete", key, NA_INTEGER, R_NilValue, NA_INTEGER);
+            UNPROTECT(1);
+            b = AMitemsNext(&before, 1);
+        } else if (cmp > 0) {
+            SEXP key = PROTECT(key_of(a));
+            emit_value(ctx, path, "put", key, NA_INTEGER, a, after_owner);
+            UNPROTECT(1);
+            a = AMitemsNext(&after, 1);
+        } else {
+            SEXP key = PROTECT(key_of(a));
+            if (same_id(b, a)) {
+                diff_same(ctx, path, key, NA_INTEGER, b, a);
+            } else {
+                emit_value(ctx, path, "put", key, NA_INTEGER, a, after_owner);
+            }
+            UNPROTECT(1);
+            b = AMitemsNext(&before, 1);
+            a = AMitemsNext(&after, 1);
+        }
+    }
+    UNPROTECT(2);
+}
+
+static void diff_list(diff_ctx *ctx, const AMobjId *obj_id, SEXP path) {
+    AMitems before, after;
+    SEXP before_owner = PROTECT(read_items(ctx, obj_id, AM_OBJ_TYPE_LIST, 0, &before));
+    SEXP after_owner = PROTECT(read_items(ctx, obj_id, AM_OBJ_TYPE_LIST, 1, &after));
+    size_t nb = before_owner != R_NilValue ? AMitemsSize(&before) : 0;
+    size_t na = after_owner != R_NilValue ? AMitemsSize(&after) : 0;
+
+    AMitem **bs = (AMitem **) R_alloc(nb + 1, sizeof(AMitem *));
+    AMitem **as = (AMitem **) R_alloc(na + 1, sizeof(AMitem *));
+    for (size_t i = 0; i < nb; i++) bs[i] = AMitemsNext(&before, 1);
+    for (size_t i = 0; i < na; i++) as[i] = AMitemsNext(&after, 1);
+
+    // Elements that kept their identity at either end bracket the edit
+    size_t prefix = 0;
+    while (prefix < nb && prefix < na && same_id(bs[prefix], as[prefix])) prefix++;
+    size_t suffix = 0;
+    while (suffix < nb - prefix && suffix < na - prefix &&
+           same_id(bs[nb - 1 - suffix], as[na - 1 - suffix])) {
+        suffix++;
+    }
+
+    for (size_t i = 0; i < prefix; i++) {
+        diff_same(ctx, path, NA_STRING, (int) i + 1, bs[i], as[i]);
+    }
+
+    size_t n_old = nb - prefix - suffix;
+    size_t n_new = na - prefix - suffix;
+    if (n_old == n_new) {
+        // Same number of elements: report them as overwritten in place
+        for (size_t i = 0; i < n_new; i++) {
+            emit_value(ctx, path, "put", NA_STRING, (int) (prefix + i) + 1,
+                       as[prefix + i], after_owner);
+        }
+    } else {
+        if (n_old > 0) {
+            log_add(&ctx->log, path, "delete", NA_STRING, (int) prefix + 1,
+                    R_NilValue, (int) n_old);
+        }
+        for (size_t i = 0; i < n_new; i++) {
+            emit_value(ctx, path, "insert", NA_STRING, (int) (prefix + i) + 1,
+                       as[prefix + i], after_owner);
+        }
+    }
+
+    for (size_t i = 0; i < suffix; i++) {
+        size_t ib = nb - suffix + i;
+        size_t ia = na - suffix + i;
+        diff_same(ctx, path, NA_STRING, (int) ia + 1, bs[ib], as[ia]);
+    }
+    UNPROTECT(2);
+}
+
+static void diff_text(diff_ctx *ctx, const AMobjId *obj_id, SEXP path) {
+    AMbyteSpan before, after;
+    PROTECT(read_text(ctx, obj_id, 0, &before));
+    PROTECT(read_text(ctx, obj_id, 1, &after));
+
+    // Common prefix and suffix in bytes, backed off to character boundaries
+    size_t n = before.count < after.count ? before.count : after.count;
+    size_t prefix = 0;
+    while (prefix < n && before.src[prefix] == after.src[prefix]) prefix++;
+    while (prefix > 0 && prefix < after.count && (after.src[prefix] & 0xC0) == 0x80) prefix--;
+    size_t suffix = 0;
+    while (suffix < n - prefix &&
+           before.src[before.count - 1 - suffix] == after.src[after.count - 1 - suffix]) {
+        suffix++;
+    }
+    while (suffix > 0 && (after.src[after.count - suffix] & 0xC0) == 0x80) suffix--;
+
+    int index = (int) count_chars(after.src, prefix) + 1;
+    size_t deleted = count_chars(before.src + prefix, before.count - prefix - suffix);
+    if (deleted > 0) {
+        log_add(&ctx->log, path, "delete", NA_STRING, index, R_NilValue, (int) deleted);
+    }
+    size_t inserted_bytes = after.count - prefix - suffix;
+    if (inserted_bytes > 0) {
+        SEXP value = Rf_ScalarString(Rf_mkCharLenCE((const char *) after.src + prefix,
+                                                    (int) inserted_bytes, CE_UTF8));
+        log_add(&ctx->log, path, "splice", NA_STRING, index, value,
+                (int) count_chars(after.src + prefix, inserted_bytes));
+    }
+    UNPROTECT(2);
+}
+
+// Diff an object that exists at both points
+static void diff_object(diff_ctx *ctx, const AMobjId *obj_id, SEXP path) {
+    AMobjType type = obj_id ? AMobjObjType(ctx->doc, obj_id) : AM_OBJ_TYPE_MAP;
+    switch (type) {
+        case AM_OBJ_TYPE_MAP:
+            diff_map(ctx, obj_id, path);
+            break;
+        case AM_OBJ_TYPE_LIST:
+            diff_list(ctx, obj_id, path);
+            break;
+        case AM_OBJ_TYPE_TEXT:
+            diff_text(ctx, obj_id, path);
+            break;
+        default:
+            break;
+    }
+}
+
+// Build an object that is new at "after" by diffing it against nothing
+static void build_object(diff_ctx *ctx, const AMobjId *obj_id, SEXP path) {
+    int before_empty = ctx->before_empty;
+    ctx->before_empty = 1;
+    diff_object(ctx, obj_id, path);
+    ctx->before_empty = before_empty;
+}
+
+static SEXP diff_run(SEXP doc_ptr, AMitems const *before, int before_empty,
+                     AMitems const *after, int after_empty) {
+    diff_ctx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.doc = get_doc(doc_ptr);
+    ctx.doc_ptr = doc_ptr;
+    if (before) {
+        ctx.before = *before;
+        ctx.has_before = 1;
+    }
+    if (after) {
+        ctx.after = *after;
+        ctx.has_after = 1;
+    }
+    ctx.before_empty = before_empty;
+    ctx.after_empty = after_empty;
+
+    // Nothing to walk if both sides are the same point in history, which is
+    // common after integrating a sync message that carried no changes
+    int same = before_empty && after_empty;
+    if (!same && !before_empty && !after_empty) {
+        if (after) {
+            same = AMitemsEqual(before, after);
+        } else {
+            AMresult *heads = AMgetHeads(ctx.doc);
+            CHECK_RESULT(heads, AM_VAL_TYPE_VOID);
+            AMitems current = AMresultItems(heads);
+            same = AMitemsEqual(before, &current);
+            AMresultFree(heads);
+        }
+    }
+
+    log_init(&ctx.log);
+    SEXP root = PROTECT(Rf_allocVector(VECSXP, 0));
+    if (!same) {
+        diff_object(&ctx, AM_ROOT, root);
+    }
+    SEXP out = log_finish(&ctx.log);
+    UNPROTECT(2);
+    return out;
+}
+
+/**
+ * Compute the patches that take a document from one point in its history
+ * to another.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param before Heads to diff from, or NULL for the empty document
+ * @param after Heads to diff to, or NULL for the current state
+ * @return Data frame of patches (see the column description above)
+ */
+SEXP am_diff_heads(SEXP doc_ptr, AMitems const *before, AMitems const *after) {
+    return diff_run(doc_ptr, before, before == NULL, after, 0);
+}
+
+/**
+ * Compute the patches between two sets of heads.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param before List of raw vectors (change hashes); an empty list is the
+ *   empty document
+ * @param after List of raw vectors (change hashes), or NULL for the current
+ *   state; an empty list is the empty document
+ * @return Data frame of patches
+ */
+SEXP C_am_diff(SEXP doc_ptr, SEXP before, SEXP after) {
+    get_doc(doc_ptr);
+    if (TYPEOF(before) != VECSXP) {
+        Rf_error("before must be a list of raw vectors (change hashes)");
+    }
+    if (after != R_NilValue && TYPEOF(after) != VECSXP) {
+        Rf_error("after must be NULL or a list of raw vectors (change hashes)");
+    }
+
+    AMresult *before_result = am_heads_to_result(before);
+    PROTECT(before_result ? wrap_am_result(before_result, R_NilValue) : R_NilValue);
+    AMresult *after_result = am_heads_to_result(after);
+    PROTECT(after_result ? wrap_am_result(after_result, R_NilValue) : R_NilValue);
+
+    AMitems before_items, after_items;
+    if (before_result) before_items = AMresultItems(before_result);
+    if (after_result) after_items = AMresultItems(after_result);
+
+    SEXP out = diff_run(doc_ptr,
+                        before_result ? &before_items : NULL, before_result == NULL,
+                        after_result ? &after_items : NULL,
+                        after != R_NilValue && after_result == NULL);
+    UNPROTECT(2);
+    return out;
+}
+
+/**
+ * Compute the patches since the previous call for this document and move
+ * the document's diff cursor to its current heads.
+ *
+ * The cursor starts at the empty document, so the first call reports the
+ * whole document. Each call with new changes is a full diff_run(), reading
+ * every object at both the cursor and the current heads: O(document), not
+ * O(changes since the last call).
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @return Data frame of patches
+ */
+SEXP C_am_patches_since_last(SEXP doc_ptr) {
+    AMdoc *doc = get_doc(doc_ptr);
+    am_doc *doc_wrapper = (am_doc *) R_ExternalPtrAddr(doc_ptr);
+
+    // Held by R until the diff succeeds, then moved into the cursor
+    AMresult *heads = AMgetHeads(doc);
+    CHECK_RESULT(heads, AM_VAL_TYPE_VOID);
+    SEXP heads_owner = PROTECT(wrap_am_result(heads, R_NilValue));
+
+    SEXP out;
+    if (doc_wrapper->diff_cursor) {
+        AMitems cursor = AMresultItems(doc_wrapper->diff_cursor);
+        out = PROTECT(am_diff_heads(doc_ptr, &cursor, NULL));
+    } else {
+        out = PROTECT(am_diff_heads(doc_ptr, NULL, NULL));
+    }
+
+    R_ClearExternalPtr(heads_owner);
+    if (doc_wrapper->diff_cursor) AMresultFree(doc_wrapper->diff_cursor);
+    doc_wrapper->diff_cursor = heads;
+
+    UNPROTECT(2);
+    return out;
+}
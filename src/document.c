@@ -43,28 +43,7 @@ SEXP C_am_create(SEXP actor_id) {
 
     CHECK_RESULT(result, AM_VAL_TYPE_DOC);
 
-    AMitem *item = AMresultItem(result);
-    AMdoc *doc = NULL;
-    AMitemToDoc(item, &doc);
-
-    am_doc *doc_wrapper = malloc(sizeof(am_doc));
-    if (!doc_wrapper) {
-        AMresultFree(result);
-        Rf_error("Failed to allocate memory for document wrapper");
-    }
-    doc_wrapper->result = result;  // Owning result
-    doc_wrapper->doc = doc;        // Borrowed from result
-
-    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(doc_wrapper, R_NilValue, R_NilValue));
-    R_RegisterCFinalizer(ext_ptr, am_doc_finalizer);
-
-    SEXP class = Rf_allocVector(STRSXP, 2);
-    Rf_classgets(ext_ptr, class);
-    SET_STRING_ELT(class, 0, Rf_mkChar("am_doc"));
-    SET_STRING_ELT(class, 1, Rf_mkChar("automerge"));
-
-    UNPROTECT(1);
-    return ext_ptr;
+    return am_wrap_doc(result);
 }
 
 /**
@@ -105,157 +84,86 @@ SEXP C_am_load(SEXP data) {
     AMresult *result = AMload(RAW(data), (size_t) XLENGTH(data));
     CHECK_RESULT(result, AM_VAL_TYPE_DOC);
 
-    AMitem *item = AMresultItem(result);
-    AMdoc *doc = NULL;
-    AMitemToDoc(item, &doc);
-
-    am_doc *doc_wrapper = malloc(sizeof(am_doc));
-    if (!doc_wrapper) {
-        AMresultFree(result);
-        Rf_error("Failed to allocate memory for document wrapper");
-    }
-    doc_wrapper->result = result;
-    doc_wrapper->doc = doc;
-
-    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(doc_wrapper, R_NilValue, R_NilValue));
-    R_RegisterCFinalizer(ext_ptr, am_doc_finalizer);
-
-    SEXP class = Rf_allocVector(STRSXP, 2);
-    Rf_classgets(ext_ptr, class);
-    SET_STRING_ELT(class, 0, Rf_mkChar("am_doc"));
-    SET_STRING_ELT(class, 1, Rf_mkChar("automerge"));
-
-    UNPROTECT(1);
-    return ext_ptr;
+    return am_wrap_doc(result);
 }
 
 /**
- * Helper: Convert R list of change hashes to AMitems struct.
- *
- * Takes an R list of raw vectors (change hashes) and creates the necessary
- * AMresult objects, then extracts AMitems for use with C API functions.
+ * Fork an Automerge document at current or specified heads.
  *
- * @param heads_list R list of raw vectors (change hashes)
- * @param results_out Output parameter: array of AMresult pointers to keep alive
- * @param n_results Output parameter: number of results in array
- * @return AMresult containing change hash items (must be freed by caller)
+ * @param doc_ptr External pointer to am_doc
+ * @param heads R object: NULL for current heads, or list of change hashes (raw vectors)
+ * @return External pointer to forked am_doc
  */
-static AMresult* convert_r_heads_to_amresult(SEXP heads_list, AMresult ***results_out, size_t *n_results) {
-    if (TYPEOF(heads_list) != VECSXP) {
-        Rf_error("heads must be NULL or a list of raw vectors");
-    }
-
-    R_xlen_t n_heads = XLENGTH(heads_list);
-    if (n_heads == 0) {
-        *results_out = NULL;
-        *n_results = 0;
-        return NULL;
-    }
-
-    AMresult **results = malloc(n_heads * sizeof(AMresult *));
-    if (!results) {
-        Rf_error("Failed to allocate memory for change hash results");
-    }
-
-    for (R_xlen_t i = 0; i < n_heads; i++) {
-        SEXP r_hash = VECTOR_ELT(heads_list, i);
-        if (TYPEOF(r_hash) != RAWSXP) {
-            for (R_xlen_t j = 0; j < i; j++) {
-                AMresultFree(results[j]);
-            }
-            free(results);
-            Rf_error("All heads must be raw vectors (change hashes)");
-        }
+SEXP C_am_fork(SEXP doc_ptr, SEXP heads) {
+    AMdoc *doc = get_doc(doc_ptr);
 
-        AMbyteSpan hash_span = {
-            .src = RAW(r_hash),
-            .count = (size_t) XLENGTH(r_hash)
-        };
-
-        results[i] = AMitemFromChangeHash(hash_span);
-        if (!results[i] || AMresultStatus(results[i]) != AM_STATUS_OK) {
-            for (R_xlen_t j = 0; j <= i; j++) {
-                if (results[j]) AMresultFree(results[j]);
-            }
-            free(results);
-            Rf_error("Invalid change hash at index %lld", (long long) i);
-        }
+    AMresult *heads_result = am_heads_to_result(heads);
+    AMresult *result = NULL;
+    if (heads_result) {
+        AMitems heads_items = AMresultItems(heads_result);
+        result = AMfork(doc, &heads_items);
+        AMresultFree(heads_result);
+    } else {
+        result = AMfork(doc, NULL);
     }
 
-    *results_out = results;
-    *n_results = (size_t) n_heads;
-
-    if (n_heads != 1) {
-        // Lack of public API to build multi-item AMresults for AMfork
-        Rf_error("Forking at multiple specific heads not yet fully implemented (use single head or NULL)");
-    }
+    CHECK_RESULT(result, AM_VAL_TYPE_DOC);
 
-    return results[0];
+    return am_wrap_doc(result);
 }
 
 /**
- * Fork an Automerge document at current or specified heads.
+ * Save only the changes made after the given heads.
+ *
+ * Equivalent to the core's save_after(): the raw bytes of every change not
+ * reachable from `heads` are concatenated into a single chunk, which
+ * AMloadIncremental() accepts as-is.
  *
  * @param doc_ptr External pointer to am_doc
- * @param heads R object: NULL for current heads, or list of change hashes (raw vectors)
- * @return External pointer to forked am_doc
+ * @param heads R object: NULL for all changes, or list of change hashes (raw vectors)
+ * @return Raw vector containing the concatenated changes (empty if none)
  */
-SEXP C_am_fork(SEXP doc_ptr, SEXP heads) {
+SEXP C_am_save_since(SEXP doc_ptr, SEXP heads) {
     AMdoc *doc = get_doc(doc_ptr);
 
+    AMresult *heads_result = am_heads_to_result(heads);
     AMresult *result = NULL;
-    AMresult **head_results = NULL;
-    size_t n_head_results = 0;
-
-    if (heads == R_NilValue || (TYPEOF(heads) == VECSXP && XLENGTH(heads) == 0)) {
-        result = AMfork(doc, NULL);
+    if (heads_result) {
+        AMitems heads_items = AMresultItems(heads_result);
+        result = AMgetChanges(doc, &heads_items);
+        AMresultFree(heads_result);
     } else {
-        AMresult *heads_result = convert_r_heads_to_amresult(heads, &head_results, &n_head_results);
-
-        if (n_head_results == 0) {
-            result = AMfork(doc, NULL);
-        } else if (heads_result && n_head_results == 1) {
-            AMitems heads_items = AMresultItems(heads_result);
-            result = AMfork(doc, &heads_items);
-
-            AMresultFree(heads_result);
-            free(head_results);
-        } else {
-            // Multiple heads not yet implemented - clean up and error
-            if (head_results) {
-                for (size_t i = 0; i < n_head_results; i++) {
-                    AMresultFree(head_results[i]);
-                }
-                free(head_results);
-            }
-            Rf_error("Forking at multiple specific heads not yet fully implemented");
-        }
+        result = AMgetChanges(doc, NULL);
     }
 
-    CHECK_RESULT(result, AM_VAL_TYPE_DOC);
-
-    AMitem *item = AMresultItem(result);
-    AMdoc *forked_doc = NULL;
-    AMitemToDoc(item, &forked_doc);
+    if (AMresultStatus(result) != AM_STATUS_OK) {
+        CHECK_RESULT(result, AM_VAL_TYPE_CHANGE);
+    }
 
-    am_doc *doc_wrapper = malloc(sizeof(am_doc));
-    if (!doc_wrapper) {
-        AMresultFree(result);
-        Rf_error("Failed to allocate memory for forked document wrapper");
+    AMitems items = AMresultItems(result);
+    size_t total = 0;
+    AMitem *item = NULL;
+    while ((item = AMitemsNext(&items, 1)) != NULL) {
+        AMchange *change = NULL;
+        AMitemToChange(item, &change);
+        total += AMchangeRawBytes(change).count;
     }
-    doc_wrapper->result = result;
-    doc_wrapper->doc = forked_doc;
 
-    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(doc_wrapper, R_NilValue, R_NilValue));
-    R_RegisterCFinalizer(ext_ptr, am_doc_finalizer);
+    SEXP r_bytes = PROTECT(Rf_allocVector(RAWSXP, total));
 
-    SEXP class = Rf_allocVector(STRSXP, 2);
-    Rf_classgets(ext_ptr, class);
-    SET_STRING_ELT(class, 0, Rf_mkChar("am_doc"));
-    SET_STRING_ELT(class, 1, Rf_mkChar("automerge"));
+    items = AMresultItems(result);
+    size_t offset = 0;
+    while ((item = AMitemsNext(&items, 1)) != NULL) {
+        AMchange *change = NULL;
+        AMitemToChange(item, &change);
+        AMbyteSpan bytes = AMchangeRawBytes(change);
+        memcpy(RAW(r_bytes) + offset, bytes.src, bytes.count);
+        offset += bytes.count;
+    }
 
+    AMresultFree(result);
     UNPROTECT(1);
-    return ext_ptr;
+    return r_bytes;
 }
 
 /**
@@ -0,0 +1,786 @@
+#include "automerge.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Change Graph Index ----------------------------------------------------------
+//
+// Ancestry queries are answered from vector clocks. The clock of a change
+// holds, per actor, the highest sequence number among the change and its
+// ancestors. Each actor's changes form a chain, so a change c is in the
+// history of a set of heads H exactly when
+//
+//   seq(c) <= max over h in H of clock(h)[actor(c)]
+//
+// Storing a clock for every change would cost O(changes x actors) memory, so
+// the index only stores the dependencies of each change. The clock of a head
+// is computed on demand by walking its history down to changes whose clock
+// is already known, and kept in a small cache of recent clocks. History only
+// grows, so a walk from new heads stops at the cached clocks of earlier ones
+// after the changes made since, and a repeated query costs O(heads x actors).
+//
+// The index is built on first use and cached on the document. When the heads
+// move it is brought up to date by appending the changes made since the
+// cached heads, which AMgetChanges() returns in causal order.
+//
+// The index also keeps each change's last operation counter and time, so
+// the change that made an operation can be found by a binary search of its
+// actor's chain (am_blame()).
+
+#define GRAPH_HASH_SIZE 32
+#define GRAPH_EMPTY SIZE_MAX
+#define GRAPH_CLOCK_CACHE 32
+
+struct am_graph {
+    size_t n_changes;
+    size_t cap_changes;
+    uint8_t *hashes;           // n_changes x 32 bytes
+    uint32_t *actor;           // Actor index of each change
+    uint32_t *seq;             // Sequence number of each change
+    uint64_t *max_op;          // Last operation counter of each change
+    int64_t *time;             // Time of each change (ms since the epoch)
+    size_t *dep_start;         // Per change: offset of its dependencies in deps
+    size_t *deps;              // Dependency change indices, by change
+    size_t n_deps;
+    size_t cap_deps;
+    size_t *slots;             // Open-addressing table: change hash -> index
+    size_t n_slots;
+    size_t n_actors;
+    size_t cap_actors;
+    uint8_t **actor_ids;       // Actor id bytes, by actor index
+    size_t *actor_id_lens;
+    size_t *actor_slots;       // Open-addressing table: actor id -> index
+    size_t n_actor_slots;
+    size_t **chains;           // Per actor: change index by seq - 1
+    size_t *chain_lens;
+    size_t *chain_caps;
+    size_t clock_change[GRAPH_CLOCK_CACHE];  // Cached clocks: change index,
+    uint32_t *clocks[GRAPH_CLOCK_CACHE];     // clock (NULL if unused)
+    size_t clock_lens[GRAPH_CLOCK_CACHE];    // and number of actors covered
+    size_t clock_next;                       // Next cache entry to replace
+    AMresult *heads;           // Document heads when last brought up to date
+};
+
+void am_graph_free(struct am_graph *g) {
+    if (!g) return;
+    for (size_t a = 0; a < g->n_actors; a++) {
+        free(g->actor_ids[a]);
+        free(g->chains[a]);
+    }
+    free(g->hashes);
+    free(g->actor);
+    free(g->seq);
+    free(g->max_op);
+    free(g->time);
+    free(g->dep_start);
+    free(g->deps);
+    for (size_t k = 0; k < GRAPH_CLOCK_CACHE; k++) free(g->clocks[k]);
+    free(g->slots);
+    free(g->actor_ids);
+    free(g->actor_id_lens);
+    free(g->actor_slots);
+    free(g->chains);
+    free(g->chain_lens);
+    free(g->chain_caps);
+    if (g->heads) AMresultFree(g->heads);
+    free(g);
+}
+
+// Change hashes are uniformly distributed, so their leading bytes serve
+// directly as the table hash
+static size_t hash_slot(const uint8_t *hash, size_t n_slots) {
+    uint64_t h;
+    memcpy(&h, hash, sizeof(h));
+    return (size_t) h & (n_slots - 1);
+}
+
+static size_t find_change(const struct am_graph *g, const uint8_t *hash) {
+    if (g->n_slots == 0) return GRAPH_EMPTY;
+    size_t s = hash_slot(hash, g->n_slots);
+    for (; g->slots[s] != GRAPH_EMPTY; s = (s + 1) & (g->n_slots - 1)) {
+        if (memcmp(g->hashes + g->slots[s] * GRAPH_HASH_SIZE, hash, GRAPH_HASH_SIZE) == 0) {
+            return g->slots[s];
+        }
+    }
+    return GRAPH_EMPTY;
+}
+
+static int rehash_changes(struct am_graph *g, size_t n_slots) {
+    size_t *slots = malloc(n_slots * sizeof(size_t));
+    if (!slots) return 0;
+    for (size_t s = 0; s < n_slots; s++) slots[s] = GRAPH_EMPTY;
+    for (size_t i = 0; i < g->n_changes; i++) {
+        size_t s = hash_slot(g->hashes + i * GRAPH_HASH_SIZE, n_slots);
+        while (slots[s] != GRAPH_EMPTY) s = (s + 1) & (n_slots - 1);
+        slots[s] = i;
+    }
+    free(g->slots);
+    g->slots = slots;
+    g->n_slots = n_slots;
+    return 1;
+}
+
+static int grow_changes(struct am_graph *g) {
+    size_t cap = g->cap_changes ? 2 * g->cap_changes : 256;
+    uint8_t *hashes = realloc(g->hashes, cap * GRAPH_HASH_SIZE);
+    if (!hashes) return 0;
+    g->hashes = hashes;
+    uint32_t *actor = realloc(g->actor, cap * sizeof(uint32_t));
+    if (!actor) return 0;
+    g->actor = actor;
+    uint32_t *seq = realloc(g->seq, cap * sizeof(uint32_t));
+    if (!seq) return 0;
+    g->seq = seq;
+    uint64_t *max_op = realloc(g->max_op, cap * sizeof(uint64_t));
+    if (!max_op) return 0;
+    g->max_op = max_op;
+    int64_t *time = realloc(g->time, cap * sizeof(int64_t));
+    if (!time) return 0;
+    g->time = time;
+    size_t *dep_start = realloc(g->dep_start, (cap + 1) * sizeof(size_t));
+    if (!dep_start) return 0;
+    if (!g->dep_start) dep_start[0] = 0;
+    g->dep_start = dep_start;
+    g->cap_changes = cap;
+    return 1;
+}
+
+static int grow_deps(struct am_graph *g) {
+    size_t cap = g->cap_deps ? 2 * g->cap_deps : 256;
+    size_t *deps = realloc(g->deps, cap * sizeof(size_t));
+    if (!deps) return 0;
+    g->deps = deps;
+    g->cap_deps = cap;
+    return 1;
+}
+
+static size_t find_actor(const struct am_graph *g, AMbyteSpan id) {
+    if (g->n_actor_slots == 0) return GRAPH_EMPTY;
+    size_t s = am_hash_bytes(id.src, id.count) & (g->n_actor_slots - 1);
+    for (; g->actor_slots[s] != GRAPH_EMPTY; s = (s + 1) & (g->n_actor_slots - 1)) {
+        size_t a = g->actor_slots[s];
+        if (g->actor_id_lens[a] == id.count &&
+            memcmp(g->actor_ids[a], id.src, id.count) == 0) {
+            return a;
+        }
+    }
+    return GRAPH_EMPTY;
+}
+
+// Return the index of an actor, adding it if it is new, or GRAPH_EMPTY if
+// memory runs out
+static size_t intern_actor(struct am_graph *g, AMbyteSpan id) {
+    size_t found = find_actor(g, id);
+    if (found != GRAPH_EMPTY) return found;
+
+    if (g->n_actors == g->cap_actors) {
+        size_t cap = g->cap_actors ? 2 * g->cap_actors : 8;
+        uint8_t **ids = realloc(g->actor_ids, cap * sizeof(uint8_t *));
+        if (!ids) return GRAPH_EMPTY;
+        g->actor_ids = ids;
+        size_t *lens = realloc(g->actor_id_lens, cap * sizeof(size_t));
+        if (!lens) return GRAPH_EMPTY;
+        g->actor_id_lens = lens;
+        size_t **chains = realloc(g->chains, cap * sizeof(size_t *));
+        if (!chains) return GRAPH_EMPTY;
+        g->chains = chains;
+        size_t *chain_lens = realloc(g->chain_lens, cap * sizeof(size_t));
+        if (!chain_lens) return GRAPH_EMPTY;
+        g->chain_lens = chain_lens;
+        size_t *chain_caps = realloc(g->chain_caps, cap * sizeof(size_t));
+        if (!chain_caps) return GRAPH_EMPTY;
+        g->chain_caps = chain_caps;
+        g->cap_actors = cap;
+    }
+
+    if (2 * (g->n_actors + 1) > g->n_actor_slots) {
+        size_t n_slots = g->n_actor_slots ? 2 * g->n_actor_slots : 16;
+        size_t *slots = malloc(n_slots * sizeof(size_t));
+        if (!slots) return GRAPH_EMPTY;
+        for (size_t s = 0; s < n_slots; s++) slots[s] = GRAPH_EMPTY;
+        for (size_t a = 0; a < g->n_actors; a++) {
+            size_t s = am_hash_bytes(g->actor_ids[a], g->actor_id_lens[a]) & (n_slots - 1);
+            while (slots[s] != GRAPH_EMPTY) s = (s + 1) & (n_slots - 1);
+            slots[s] = a;
+        }
+        free(g->actor_slots);
+        g->actor_slots = slots;
+        g->n_actor_slots = n_slots;
+    }
+
+    uint8_t *copy = malloc(id.count > 0 ? id.count : 1);
+    if (!copy) return GRAPH_EMPTY;
+    memcpy(copy, id.src, id.count);
+
+    size_t a = g->n_actors++;
+    g->actor_ids[a] = copy;
+    g->actor_id_lens[a] = id.count;
+    g->chains[a] = NULL;
+    g->chain_lens[a] = 0;
+    g->chain_caps[a] = 0;
+
+    size_t s = am_hash_bytes(id.src, id.count) & (g->n_actor_slots - 1);
+    while (g->actor_slots[s] != GRAPH_EMPTY) s = (s + 1) & (g->n_actor_slots - 1);
+    g->actor_slots[s] = a;
+    return a;
+}
+
+// Record change i as sequence number seq in its actor's chain
+static int chain_append(struct am_graph *g, size_t a, uint32_t seq, size_t i) {
+    if (seq == 0) return 1;
+    if (seq > g->chain_caps[a]) {
+        size_t cap = g->chain_caps[a] ? g->chain_caps[a] : 8;
+        while (cap < seq) cap *= 2;
+        size_t *chain = realloc(g->chains[a], cap * sizeof(size_t));
+        if (!chain) return 0;
+        g->chains[a] = chain;
+        g->chain_caps[a] = cap;
+    }
+    for (size_t k = g->chain_lens[a]; k < seq; k++) g->chains[a][k] = GRAPH_EMPTY;
+    if (seq > g->chain_lens[a]) g->chain_lens[a] = seq;
+    g->chains[a][seq - 1] = i;
+    return 1;
+}
+
+// Append one change (whose dependencies are already indexed)
+static int add_change(struct am_graph *g, AMchange *change) {
+    AMbyteSpan hash = AMchangeHash(change);
+    if (hash.count != GRAPH_HASH_SIZE) return 0;
+    if (find_change(g, hash.src) != GRAPH_EMPTY) return 1;
+
+    AMresult *actor_result = AMchangeActorId(change);
+    if (AMresultStatus(actor_result) != AM_STATUS_OK) {
+        AMresultFree(actor_result);
+        return 0;
+    }
+    AMactorId const *actor_id = NULL;
+    AMitemToActorId(AMresultItem(actor_result), &actor_id);
+    size_t a = intern_actor(g, AMactorIdBytes(actor_id));
+    AMresultFree(actor_result);
+    if (a == GRAPH_EMPTY) return 0;
+
+    if (g->n_changes == g->cap_changes && !grow_changes(g)) return 0;
+    if (2 * (g->n_changes + 1) > g->n_slots &&
+        !rehash_changes(g, g->n_slots ? 2 * g->n_slots : 512)) {
+        return 0;
+    }
+
+    size_t i = g->n_changes;
+    uint64_t seq = AMchangeSeq(change);
+    if (seq > UINT32_MAX) return 0;
+
+    AMresult *deps_result = AMchangeDeps(change);
+    if (AMresultStatus(deps_result) != AM_STATUS_OK) {
+        AMresultFree(deps_result);
+        return 0;
+    }
+    AMitems deps = AMresultItems(deps_result);
+    AMitem *item = NULL;
+    while ((item = AMitemsNext(&deps, 1)) != NULL) {
+        AMbyteSpan dep;
+        AMitemToChangeHash(item, &dep);
+        size_t d = dep.count == GRAPH_HASH_SIZE ? find_change(g, dep.src) : GRAPH_EMPTY;
+        if (d == GRAPH_EMPTY) continue;
+        if (g->n_deps == g->cap_deps && !grow_deps(g)) {
+            AMresultFree(deps_result);
+            return 0;
+        }
+        g->deps[g->n_deps++] = d;
+    }
+    AMresultFree(deps_result);
+
+    if (!chain_append(g, a, (uint32_t) seq, i)) return 0;
+
+    memcpy(g->hashes + i * GRAPH_HASH_SIZE, hash.src, GRAPH_HASH_SIZE);
+    g->actor[i] = (uint32_t) a;
+    g->seq[i] = (uint32_t) seq;
+    g->max_op[i] = AMchangeMaxOp(change);
+    g->time[i] = AMchangeTime(change);
+    g->dep_start[i + 1] = g->n_deps;
+    size_t s = hash_slot(hash.src, g->n_slots);
+    while (g->slots[s] != GRAPH_EMPTY) s = (s + 1) & (g->n_slots - 1);
+    g->slots[s] = i;
+    g->n_changes++;
+    return 1;
+}
+
+/**
+ * Get the change graph index of a document, building it or bringing it up
+ * to date with the document's current heads as needed.
+ */
+static struct am_graph *get_graph(SEXP doc_ptr) {
+    AMdoc *doc = get_doc(doc_ptr);
+    am_doc *doc_wrapper = (am_doc *) R_ExternalPtrAddr(doc_ptr);
+
+    AMresult *heads_result = AMgetHeads(doc);
+    CHECK_RESULT(heads_result, AM_VAL_TYPE_VOID);
+    AMitems heads = AMresultItems(heads_result);
+
+    struct am_graph *g = doc_wrapper->graph;
+    if (g) {
+        AMitems cached = AMresultItems(g->heads);
+        if (AMitemsEqual(&cached, &heads)) {
+            AMresultFree(heads_result);
+            return g;
+        }
+    } else {
+        g = calloc(1, sizeof(struct am_graph));
+        if (!g) {
+            AMresultFree(heads_result);
+            Rf_error("Failed to allocate memory for change graph");
+        }
+        doc_wrapper->graph = g;
+    }
+
+    AMresult *result = NULL;
+    if (g->heads) {
+        AMitems cached = AMresultItems(g->heads);
+        result = AMgetChanges(doc, &cached);
+    } else {
+        result = AMgetChanges(doc, NULL);
+    }
+
+    int ok = AMresultStatus(result) == AM_STATUS_OK;
+    if (ok) {
+        AMitems items = AMresultItems(result);
+        AMitem *item = NULL;
+        while (ok && (item = AMitemsNext(&items, 1)) != NULL) {
+            AMchange *change = NULL;
+            AMitemToChange(item, &change);
+            ok = add_change(g, change);
+        }
+    }
+    AMresultFree(result);
+
+    if (!ok) {
+        // A partly updated index cannot be resumed, so rebuild on next use
+        am_graph_free(g);
+        doc_wrapper->graph = NULL;
+        AMresultFree(heads_result);
+        Rf_error("Failed to index the change graph");
+    }
+
+    if (g->heads) AMresultFree(g->heads);
+    g->heads = heads_result;
+    return g;
+}
+
+/**
+ * Resolve a list of change hashes to change indices.
+ *
+ * @param g Change graph index
+ * @param heads List of raw vectors (change hashes), or NULL
+ * @param n Set to the number of heads
+ * @return Change indices (R_alloc), valid until the end of the .Call
+ */
+static size_t *resolve_heads(const struct am_graph *g, SEXP heads, R_xlen_t *n) {
+    *n = 0;
+    if (heads == R_NilValue) return NULL;
+    if (TYPEOF(heads) != VECSXP) {
+        Rf_error("heads must be a list of raw vectors (change hashes)");
+    }
+    *n = XLENGTH(heads);
+    size_t *idx = (size_t *) R_alloc(*n > 0 ? *n : 1, sizeof(size_t));
+    for (R_xlen_t i = 0; i < *n; i++) {
+        SEXP hash = VECTOR_ELT(heads, i);
+        if (TYPEOF(hash) != RAWSXP) {
+            Rf_error("All heads must be raw vectors (change hashes)");
+        }
+        if (XLENGTH(hash) != GRAPH_HASH_SIZE) {
+            Rf_error("Invalid change hash at index %lld", (long long) i);
+        }
+        idx[i] = find_change(g, RAW(hash));
+        if (idx[i] == GRAPH_EMPTY) {
+            Rf_error("Unknown change hash at index %lld", (long long) i);
+        }
+    }
+    return idx;
+}
+
+// Clocks ----------------------------------------------------------------------
+
+// Cached clock of change c and the number of actors it covers (later actors
+// are 0), or NULL
+static const uint32_t *cached_clock(const struct am_graph *g, size_t c, size_t *len) {
+    for (size_t k = 0; k < GRAPH_CLOCK_CACHE; k++) {
+        if (g->clocks[k] && g->clock_change[k] == c) {
+            *len = g->clock_lens[k];
+            return g->clocks[k];
+        }
+    }
+    return NULL;
+}
+
+// Cache the clock of change c (taking ownership), replacing the oldest entry
+static void cache_clock(struct am_graph *g, size_t c, uint32_t *clock, size_t len) {
+    size_t k = g->clock_next;
+    free(g->clocks[k]);
+    g->clocks[k] = clock;
+    g->clock_change[k] = c;
+    g->clock_lens[k] = len;
+    g->clock_next = (k + 1) % GRAPH_CLOCK_CACHE;
+}
+
+static void merge_clock(uint32_t *into, const uint32_t *clock, size_t len) {
+    for (size_t x = 0; x < len; x++) {
+        if (clock[x] > into[x]) into[x] = clock[x];
+    }
+}
+
+// Depth-first walk down the history of some changes, visiting each change
+// once
+typedef struct {
+    size_t *stack;
+    size_t n;
+    size_t cap;
+    uint8_t *seen;             // Bitmap over change indices
+} graph_walk;
+
+static int walk_init(graph_walk *w, const struct am_graph *g) {
+    w->n = 0;
+    w->cap = 64;
+    w->stack = malloc(w->cap * sizeof(size_t));
+    w->seen = calloc(g->n_changes / 8 + 1, 1);
+    return w->stack && w->seen;
+}
+
+static void walk_free(graph_walk *w) {
+    free(w->stack);
+    free(w->seen);
+}
+
+static int walk_push(graph_walk *w, size_t c) {
+    uint8_t bit = (uint8_t) (1u << (c & 7));
+    if (w->seen[c >> 3] & bit) return 1;
+    w->seen[c >> 3] |= bit;
+    if (w->n == w->cap) {
+        size_t *stack = realloc(w->stack, 2 * w->cap * sizeof(size_t));
+        if (!stack) return 0;
+        w->stack = stack;
+        w->cap *= 2;
+    }
+    w->stack[w->n++] = c;
+    return 1;
+}
+
+static int walk_push_deps(graph_walk *w, const struct am_graph *g, size_t c) {
+    for (size_t k = g->dep_start[c]; k < g->dep_start[c + 1]; k++) {
+        if (!walk_push(w, g->deps[k])) return 0;
+    }
+    return 1;
+}
+
+// Merge the clock of change c into `into`, computing and caching it if it is
+// not cached. Returns 0 if memory runs out.
+static int merge_change_clock(struct am_graph *g, size_t c, uint32_t *into) {
+    size_t len;
+    const uint32_t *known = cached_clock(g, c, &len);
+    if (!known) {
+        len = g->n_actors;
+        uint32_t *clock = calloc(len > 0 ? len : 1, sizeof(uint32_t));
+        graph_walk w = {NULL, 0, 0, NULL};
+        int ok = clock && walk_init(&w, g) && walk_push(&w, c);
+        while (ok && w.n > 0) {
+            size_t v = w.stack[--w.n];
+            size_t v_len;
+            const uint32_t *v_clock = cached_clock(g, v, &v_len);
+            if (v_clock) {
+                merge_clock(clock, v_clock, v_len);
+            } else {
+                if (g->seq[v] > clock[g->actor[v]]) clock[g->actor[v]] = g->seq[v];
+                ok = walk_push_deps(&w, g, v);
+            }
+        }
+        walk_free(&w);
+        if (!ok) {
+            free(clock);
+            return 0;
+        }
+        cache_clock(g, c, clock, len);
+        known = clock;
+    }
+    merge_clock(into, known, len);
+    return 1;
+}
+
+// Vector clock of the union of the histories of a set of heads
+static uint32_t *heads_clock(struct am_graph *g, const size_t *idx, R_xlen_t n) {
+    size_t width = g->n_actors > 0 ? g->n_actors : 1;
+    uint32_t *clock = (uint32_t *) R_alloc(width, sizeof(uint32_t));
+    memset(clock, 0, width * sizeof(uint32_t));
+    for (R_xlen_t i = 0; i < n; i++) {
+        if (!merge_change_clock(g, idx[i], clock)) {
+            Rf_error("Failed to allocate memory for change graph");
+        }
+    }
+    return clock;
+}
+
+// Queries ---------------------------------------------------------------------
+
+static int compare_index(const void *a, const void *b) {
+    size_t x = *(const size_t *) a, y = *(const size_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Test whether one set of heads is contained in the history of another.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param a List of raw vectors (change hashes)
+ * @param b List of raw vectors (change hashes)
+ * @return Logical scalar: TRUE if every change in a is an ancestor of (or
+ *   equal to) a change in b
+ */
+SEXP C_am_is_ancestor(SEXP doc_ptr, SEXP a, SEXP b) {
+    struct am_graph *g = get_graph(doc_ptr);
+    R_xlen_t n_a, n_b;
+    size_t *idx_a = resolve_heads(g, a, &n_a);
+    size_t *idx_b = resolve_heads(g, b, &n_b);
+    uint32_t *clock = heads_clock(g, idx_b, n_b);
+
+    for (R_xlen_t i = 0; i < n_a; i++) {
+        if (g->seq[idx_a[i]] > clock[g->actor[idx_a[i]]]) {
+            return Rf_ScalarLogical(FALSE);
+        }
+    }
+    return Rf_ScalarLogical(TRUE);
+}
+
+/**
+ * Find the lowest common ancestors of two sets of heads.
+ *
+ * The shared history is given by the element-wise minimum of the two
+ * clocks. Its heads are found among the last shared change of each actor:
+ * a candidate is a head unless it is in the history of another candidate,
+ * found by one walk down from the candidates' dependencies.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param a List of raw vectors (change hashes)
+ * @param b List of raw vectors (change hashes)
+ * @return List of raw vectors: the heads of the shared history, in causal
+ *   order (empty if the histories share no changes)
+ */
+SEXP C_am_common_ancestors(SEXP doc_ptr, SEXP a, SEXP b) {
+    struct am_graph *g = get_graph(doc_ptr);
+    R_xlen_t n_a, n_b;
+    size_t *idx_a = resolve_heads(g, a, &n_a);
+    size_t *idx_b = resolve_heads(g, b, &n_b);
+    uint32_t *clock = heads_clock(g, idx_a, n_a);
+    uint32_t *clock_b = heads_clock(g, idx_b, n_b);
+    for (size_t x = 0; x < g->n_actors; x++) {
+        if (clock_b[x] < clock[x]) clock[x] = clock_b[x];
+    }
+
+    size_t *candidates = (size_t *) R_alloc(g->n_actors > 0 ? g->n_actors : 1, sizeof(size_t));
+    size_t n_candidates = 0;
+    for (size_t x = 0; x < g->n_actors; x++) {
+        if (clock[x] > 0 && clock[x] <= g->chain_lens[x] &&
+            g->chains[x][clock[x] - 1] != GRAPH_EMPTY) {
+            candidates[n_candidates++] = g->chains[x][clock[x] - 1];
+        }
+    }
+
+    // Candidates reached by the walk, by actor. Every change reached is in
+    // the shared history, so it is the candidate of its actor exactly when
+    // its sequence number equals the shared clock.
+    uint8_t *covered = (uint8_t *) R_alloc(g->n_actors > 0 ? g->n_actors : 1, 1);
+    memset(covered, 0, g->n_actors > 0 ? g->n_actors : 1);
+    graph_walk w = {NULL, 0, 0, NULL};
+    int ok = walk_init(&w, g);
+    for (size_t i = 0; ok && i < n_candidates; i++) {
+        ok = walk_push_deps(&w, g, candidates[i]);
+    }
+    while (ok && w.n > 0) {
+        size_t v = w.stack[--w.n];
+        size_t len;
+        const uint32_t *v_clock = cached_clock(g, v, &len);
+        if (v_clock) {
+            for (size_t i = 0; i < n_candidates; i++) {
+                size_t x = g->actor[candidates[i]];
+                if (x < len && v_clock[x] >= g->seq[candidates[i]]) covered[x] = 1;
+            }
+        } else {
+            if (g->seq[v] == clock[g->actor[v]]) covered[g->actor[v]] = 1;
+            ok = walk_push_deps(&w, g, v);
+        }
+    }
+    walk_free(&w);
+    if (!ok) {
+        Rf_error("Failed to allocate memory for change graph");
+    }
+
+    size_t n_out = 0;
+    for (size_t i = 0; i < n_candidates; i++) {
+        if (!covered[g->actor[candidates[i]]]) candidates[n_out++] = candidates[i];
+    }
+    qsort(candidates, n_out, sizeof(size_t), compare_index);
+
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, (R_xlen_t) n_out));
+    for (size_t i = 0; i < n_out; i++) {
+        SEXP hash = Rf_allocVector(RAWSXP, GRAPH_HASH_SIZE);
+        memcpy(RAW(hash), g->hashes + candidates[i] * GRAPH_HASH_SIZE, GRAPH_HASH_SIZE);
+        SET_VECTOR_ELT(out, i, hash);
+    }
+    UNPROTECT(1);
+    return out;
+}
+
+/**
+ * Count the changes in the history of one set of heads that are not in the
+ * history of another.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param from List of raw vectors (change hashes)
+ * @param to List of raw vectors (change hashes)
+ * @return Numeric scalar: the number of changes reachable from to but not
+ *   from from
+ */
+SEXP C_am_changes_between(SEXP doc_ptr, SEXP from, SEXP to) {
+    struct am_graph *g = get_graph(doc_ptr);
+    R_xlen_t n_from, n_to;
+    size_t *idx_from = resolve_heads(g, from, &n_from);
+    size_t *idx_to = resolve_heads(g, to, &n_to);
+    uint32_t *clock_from = heads_clock(g, idx_from, n_from);
+    uint32_t *clock_to = heads_clock(g, idx_to, n_to);
+
+    double count = 0;
+    for (size_t x = 0; x < g->n_actors; x++) {
+        if (clock_to[x] > clock_from[x]) count += clock_to[x] - clock_from[x];
+    }
+    return Rf_ScalarReal(count);
+}
+
+// Find the change that made operation counter@actor: the first change in
+// the actor's chain whose last operation counter is at least counter
+static size_t find_op_change(const struct am_graph *g, size_t a, uint64_t counter) {
+    size_t lo = 0, hi = g->chain_lens[a];
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t c = g->chains[a][mid];
+        if (c == GRAPH_EMPTY) return GRAPH_EMPTY;
+        if (g->max_op[c] < counter) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < g->chain_lens[a] ? g->chains[a][lo] : GRAPH_EMPTY;
+}
+
+/**
+ * Find the operation and change that set each value of a map or list.
+ *
+ * The object is read with a single range query. Each value carries the id
+ * (counter@actor) of the operation that set it, which is resolved to its
+ * change through the change graph index.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param obj_ptr External pointer to AMobjId (or NULL for root)
+ * @return Named list of columns: key, index, op, actor, hash, time
+ */
+SEXP C_am_blame(SEXP doc_ptr, SEXP obj_ptr) {
+    static const char digits[] = "0123456789abcdef";
+    struct am_graph *g = get_graph(doc_ptr);
+    AMdoc *doc = get_doc(doc_ptr);
+    const AMobjId *obj_id = get_objid(obj_ptr);
+
+    AMobjType obj_type = obj_id ? AMobjObjType(doc, obj_id) : AM_OBJ_TYPE_MAP;
+    AMresult *result = NULL;
+    if (obj_type == AM_OBJ_TYPE_MAP) {
+        AMbyteSpan none = {NULL, 0};
+        result = AMmapRange(doc, obj_id, none, none, NULL);
+    } else if (obj_type == AM_OBJ_TYPE_LIST) {
+        result = AMlistRange(doc, obj_id, 0, SIZE_MAX, NULL);
+    } else {
+        Rf_error("obj must be a map or list");
+    }
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+    PROTECT(wrap_am_result(result, doc_ptr));
+
+    AMitems items = AMresultItems(result);
+    R_xlen_t count = (R_xlen_t) AMitemsSize(&items);
+
+    const char *names[] = {"key", "index", "op", "actor", "hash", "time", ""};
+    SEXP out = PROTECT(Rf_mkNamed(VECSXP, names));
+    SEXP key = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 0, key);
+    SEXP index = Rf_allocVector(INTSXP, count);
+    SET_VECTOR_ELT(out, 1, index);
+    SEXP op = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 2, op);
+    SEXP actor = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 3, actor);
+    SEXP hash = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 4, hash);
+    SEXP time = Rf_allocVector(REALSXP, count);
+    SET_VECTOR_ELT(out, 5, time);
+
+    SEXP classes = Rf_allocVector(STRSXP, 2);
+    Rf_classgets(time, classes);
+    SET_STRING_ELT(classes, 0, Rf_mkChar("POSIXct"));
+    SET_STRING_ELT(classes, 1, Rf_mkChar("POSIXt"));
+
+    // Actor hex strings, made once per actor
+    SEXP actor_chars = PROTECT(Rf_allocVector(STRSXP, (R_xlen_t) g->n_actors));
+    for (size_t a = 0; a < g->n_actors; a++) SET_STRING_ELT(actor_chars, a, NA_STRING);
+    char *op_str = NULL;
+    size_t op_cap = 0;
+
+    for (R_xlen_t i = 0; i < count; i++) {
+        AMitem *item = AMitemsNext(&items, 1);
+        if (!item) break;
+
+        if (obj_type == AM_OBJ_TYPE_MAP) {
+            AMbyteSpan k;
+            AMitemKey(item, &k);
+            SET_STRING_ELT(key, i, Rf_mkCharLenCE((const char *) k.src, (int) k.count, CE_UTF8));
+            INTEGER(index)[i] = NA_INTEGER;
+        } else {
+            SET_STRING_ELT(key, i, NA_STRING);
+            INTEGER(index)[i] = (int) i + 1;
+        }
+
+        SET_STRING_ELT(op, i, NA_STRING);
+        SET_STRING_ELT(actor, i, NA_STRING);
+        SET_STRING_ELT(hash, i, NA_STRING);
+        REAL(time)[i] = NA_REAL;
+
+        AMobjId const *op_id = AMitemObjId(item);
+        AMactorId const *actor_id = op_id ? AMobjIdActorId(op_id) : NULL;
+        if (!actor_id) continue;
+
+        uint64_t counter = AMobjIdCounter(op_id);
+        AMbyteSpan actor_str = AMactorIdStr(actor_id);
+        // Operation ids are written counter@actor, as by the core
+        if (32 + actor_str.count > op_cap) {
+            op_cap = 2 * (32 + actor_str.count);
+            op_str = R_alloc(op_cap, 1);
+        }
+        int prefix = snprintf(op_str, 32, "%llu@", (unsigned long long) counter);
+        memcpy(op_str + prefix, actor_str.src, actor_str.count);
+        SET_STRING_ELT(op, i, Rf_mkCharLenCE(op_str, prefix + (int) actor_str.count, CE_UTF8));
+
+        size_t a = find_actor(g, AMactorIdBytes(actor_id));
+        if (a == GRAPH_EMPTY) continue;
+        if (STRING_ELT(actor_chars, a) == NA_STRING) {
+            SET_STRING_ELT(actor_chars, a, Rf_mkCharLenCE((const char *) actor_str.src,
+                                                          (int) actor_str.count, CE_UTF8));
+        }
+        SET_STRING_ELT(actor, i, STRING_ELT(actor_chars, a));
+
+        size_t c = find_op_change(g, a, counter);
+        if (c == GRAPH_EMPTY) continue;
+        const uint8_t *h = g->hashes + c * GRAPH_HASH_SIZE;
+        char hex[2 * GRAPH_HASH_SIZE];
+        for (size_t j = 0; j < GRAPH_HASH_SIZE; j++) {
+            hex[2 * j] = digits[h[j] >> 4];
+            hex[2 * j + 1] = digits[h[j] & 0x0f];
+        }
+        SET_STRING_ELT(hash, i, Rf_mkCharLen(hex, 2 * GRAPH_HASH_SIZE));
+        // Milliseconds to seconds for POSIXct
+        REAL(time)[i] = (double) g->time[c] / 1000.0;
+    }
+
+    UNPROTECT(3);
+    return out;
+}
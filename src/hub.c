@@ -0,0 +1,370 @@
+#include "automerge.h"
+
+// Sync Hub --------------------------------------------------------------------
+//
+// A hub syncs one document with many peers. Each peer's AMsyncState lives in
+// a C hash table keyed by peer id, with the peers also kept in an array in
+// the order they were added so the outbox is generated in a stable order.
+// The document external pointer is held in the hub's protected slot, which
+// keeps the document alive for as long as the hub.
+//
+// Generating a sync message builds a bloom filter over the document's
+// history before deciding whether there is anything to send. For a peer
+// whose state has not changed since its last message was generated (nothing
+// received from it) while the document heads are also unchanged, the core
+// is guaranteed to return no message, so the outbox skips such peers without
+// calling into the core. This only helps idle peers: after an edit (local, or
+// a change received from any one peer) every peer is regenerated once, and
+// each of those AMgenerateSyncMessage() calls is still O(changes) in the
+// document history, so the main case costs one such pass per peer.
+
+#define HUB_INITIAL_BUCKETS 16
+
+typedef struct hub_peer {
+    char *id;
+    size_t id_len;
+    uint64_t hash;
+    AMresult *result;          // Owns the sync state
+    AMsyncState *state;        // Borrowed from result
+    int dirty;                 // Received a message since last generated
+    uint64_t heads_version;    // Hub heads_version at last generate
+    struct hub_peer *chain;    // Hash bucket chain
+} hub_peer;
+
+typedef struct {
+    hub_peer **buckets;
+    size_t n_buckets;
+    hub_peer **peers;          // Insertion order
+    size_t n_peers;
+    size_t cap_peers;
+    uint8_t *heads;            // Concatenated document heads at last outbox
+    size_t heads_len;
+    uint64_t heads_version;    // Incremented whenever the heads change
+} am_hub;
+
+static void peer_free(hub_peer *p) {
+    AMresultFree(p->result);
+    free(p->id);
+    free(p);
+}
+
+static void am_hub_finalizer(SEXP ext_ptr) {
+    am_hub *hub = (am_hub *) R_ExternalPtrAddr(ext_ptr);
+    if (hub) {
+        for (size_t i = 0; i < hub->n_peers; i++) {
+            peer_free(hub->peers[i]);
+        }
+        free(hub->peers);
+        free(hub->buckets);
+        free(hub->heads);
+        free(hub);
+    }
+    R_ClearExternalPtr(ext_ptr);
+}
+
+static am_hub *get_hub(SEXP hub_ptr) {
+    if (TYPEOF(hub_ptr) != EXTPTRSXP || !Rf_inherits(hub_ptr, "am_sync_hub")) {
+        Rf_error("Expected an am_sync_hub object");
+    }
+    am_hub *hub = (am_hub *) R_ExternalPtrAddr(hub_ptr);
+    if (!hub) {
+        Rf_error("Invalid sync hub pointer (NULL or freed)");
+    }
+    return hub;
+}
+
+static const char *get_peer_id(SEXP peer, size_t *len) {
+    if (TYPEOF(peer) != STRSXP || XLENGTH(peer) != 1 || STRING_ELT(peer, 0) == NA_STRING) {
+        Rf_error("peer must be a single character string");
+    }
+    *len = (size_t) LENGTH(STRING_ELT(peer, 0));
+    return CHAR(STRING_ELT(peer, 0));
+}
+
+static hub_peer *hub_find(am_hub *hub, const char *id, size_t len, uint64_t hash) {
+    hub_peer *p = hub->buckets[hash & (hub->n_buckets - 1)];
+    for (; p; p = p->chain) {
+        if (p->hash == hash && p->id_len == len && memcmp(p->id, id, len) == 0) return p;
+    }
+    return NULL;
+}
+
+// Double the bucket array once the load factor exceeds 1 (best effort)
+static void hub_grow(am_hub *hub) {
+    size_t n = hub->n_buckets * 2;
+    hub_peer **buckets = calloc(n, sizeof(hub_peer *));
+    if (!buckets) return;
+    for (size_t i = 0; i < hub->n_peers; i++) {
+        hub_peer *p = hub->peers[i];
+        p->chain = buckets[p->hash & (n - 1)];
+        buckets[p->hash & (n - 1)] = p;
+    }
+    free(hub->buckets);
+    hub->buckets = buckets;
+    hub->n_buckets = n;
+}
+
+/**
+ * Find a peer, creating it with a fresh sync state if it does not exist.
+ * Returns NULL on allocation failure.
+ */
+static hub_peer *hub_get_or_add(am_hub *hub, const char *id, size_t len) {
+    uint64_t hash = am_hash_bytes(id, len);
+    hub_peer *p = hub_find(hub, id, len, hash);
+    if (p) return p;
+
+    if (hub->n_peers == hub->cap_peers) {
+        size_t cap = hub->cap_peers ? hub->cap_peers * 2 : HUB_INITIAL_BUCKETS;
+        hub_peer **peers = realloc(hub->peers, cap * sizeof(hub_peer *));
+        if (!peers) return NULL;
+        hub->peers = peers;
+        hub->cap_peers = cap;
+    }
+
+    p = calloc(1, sizeof(hub_peer));
+    char *id_copy = malloc(len + 1);
+    AMresult *result = AMsyncStateInit();
+    if (!p || !id_copy || AMresultStatus(result) != AM_STATUS_OK) {
+        free(p);
+        free(id_copy);
+        AMresultFree(result);
+        return NULL;
+    }
+    memcpy(id_copy, id, len);
+    id_copy[len] = '\0';
+
+    p->id = id_copy;
+    p->id_len = len;
+    p->hash = hash;
+    p->result = result;
+    AMitemToSyncState(AMresultItem(result), &p->state);
+    p->dirty = 1;
+
+    size_t slot = hash & (hub->n_buckets - 1);
+    p->chain = hub->buckets[slot];
+    hub->buckets[slot] = p;
+    hub->peers[hub->n_peers++] = p;
+    if (hub->n_peers > hub->n_buckets) hub_grow(hub);
+    return p;
+}
+
+/**
+ * Create a sync hub for a document.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @return External pointer with class "am_sync_hub"
+ */
+SEXP C_am_sync_hub_new(SEXP doc_ptr) {
+    get_doc(doc_ptr);
+
+    am_hub *hub = calloc(1, sizeof(am_hub));
+    hub_peer **buckets = calloc(HUB_INITIAL_BUCKETS, sizeof(hub_peer *));
+    if (!hub || !buckets) {
+        free(hub);
+        free(buckets);
+        Rf_error("Failed to allocate memory for sync hub");
+    }
+    hub->buckets = buckets;
+    hub->n_buckets = HUB_INITIAL_BUCKETS;
+
+    // Document is kept alive through the protected slot
+    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(hub, R_NilValue, doc_ptr));
+    R_RegisterCFinalizer(ext_ptr, am_hub_finalizer);
+    Rf_classgets(ext_ptr, Rf_mkString("am_sync_hub"));
+
+    UNPROTECT(1);
+    return ext_ptr;
+}
+
+/**
+ * Apply a sync message received from a peer.
+ *
+ * The peer is registered with a fresh sync state on first contact.
+ *
+ * @param hub_ptr External pointer to am_sync_hub
+ * @param peer Character string: peer id
+ * @param message Raw vector containing an encoded sync message
+ * @return The hub pointer (invisibly, for chaining)
+ */
+SEXP C_am_sync_hub_receive(SEXP hub_ptr, SEXP peer, SEXP message) {
+    am_hub *hub = get_hub(hub_ptr);
+    AMdoc *doc = get_doc(R_ExternalPtrProtected(hub_ptr));
+    size_t len;
+    const char *id = get_peer_id(peer, &len);
+    if (TYPEOF(message) != RAWSXP) {
+        Rf_error("message must be a raw vector");
+    }
+
+    AMresult *decode_result = AMsyncMessageDecode(RAW(message), (size_t) XLENGTH(message));
+    CHECK_RESULT(decode_result, AM_VAL_TYPE_SYNC_MESSAGE);
+
+    AMsyncMessage const *msg = NULL;
+    AMitemToSyncMessage(AMresultItem(decode_result), &msg);
+
+    hub_peer *p = hub_get_or_add(hub, id, len);
+    if (!p) {
+        AMresultFree(decode_result);
+        Rf_error("Failed to allocate memory for sync hub peer");
+    }
+
+    AMresult *result = AMreceiveSyncMessage(doc, p->state, msg);
+    AMresultFree(decode_result);
+    p->dirty = 1;
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+    AMresultFree(result);
+
+    return hub_ptr;
+}
+
+/**
+ * Compare the document heads with a stored copy (concatenated hashes) and
+ * replace the copy if they differ. Also used by the socket transport.
+ *
+ * @return 1 if the heads changed since the stored copy, 0 otherwise
+ */
+int am_heads_changed(AMdoc *doc, uint8_t **stored, size_t *stored_len) {
+    AMresult *result = AMgetHeads(doc);
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+
+    AMitems items = AMresultItems(result);
+    size_t len = AMitemsSize(&items) * AM_CHANGE_HASH_SIZE;
+    uint8_t *heads = malloc(len > 0 ? len : 1);
+    if (!heads) {
+        AMresultFree(result);
+        Rf_error("Failed to allocate memory for document heads");
+    }
+
+    size_t offset = 0;
+    AMitem *item = NULL;
+    while ((item = AMitemsNext(&items, 1)) != NULL) {
+        AMbyteSpan hash;
+        AMitemToChangeHash(item, &hash);
+        memcpy(heads + offset, hash.src, hash.count);
+        offset += hash.count;
+    }
+    AMresultFree(result);
+
+    if (*stored && offset == *stored_len && memcmp(heads, *stored, offset) == 0) {
+        free(heads);
+        return 0;
+    }
+    free(*stored);
+    *stored = heads;
+    *stored_len = offset;
+    return 1;
+}
+
+// Bump heads_version if the document heads changed since the previous outbox
+static void hub_refresh_heads(am_hub *hub, AMdoc *doc) {
+    if (am_heads_changed(doc, &hub->heads, &hub->heads_len)) hub->heads_version++;
+}
+
+/**
+ * Generate the pending outgoing message for every peer.
+ *
+ * Peers that are provably idle (see the note at the top of this file) are
+ * skipped without generating a message.
+ *
+ * @param hub_ptr External pointer to am_sync_hub
+ * @return Named list of raw vectors (peer id -> message), containing only
+ *   peers that have something to send
+ */
+SEXP C_am_sync_hub_outbox(SEXP hub_ptr) {
+    am_hub *hub = get_hub(hub_ptr);
+    AMdoc *doc = get_doc(R_ExternalPtrProtected(hub_ptr));
+
+    hub_refresh_heads(hub, doc);
+
+    SEXP messages = PROTECT(Rf_allocVector(VECSXP, hub->n_peers));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, hub->n_peers));
+    R_xlen_t n_out = 0;
+
+    for (size_t i = 0; i < hub->n_peers; i++) {
+        hub_peer *p = hub->peers[i];
+        if (!p->dirty && p->heads_version == hub->heads_version) continue;
+
+        AMresult *result = AMgenerateSyncMessage(doc, p->state);
+        CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+        p->dirty = 0;
+        p->heads_version = hub->heads_version;
+        AMitem *item = AMresultItem(result);
+        if (AMitemValType(item) != AM_VAL_TYPE_SYNC_MESSAGE) {
+            AMresultFree(result);
+            continue;
+        }
+
+        AMsyncMessage const *msg = NULL;
+        AMitemToSyncMessage(item, &msg);
+        AMresult *encoded = AMsyncMessageEncode(msg);
+        AMresultFree(result);
+        CHECK_RESULT(encoded, AM_VAL_TYPE_BYTES);
+
+        AMbyteSpan bytes;
+        AMitemToBytes(AMresultItem(encoded), &bytes);
+        SEXP r_bytes = Rf_allocVector(RAWSXP, bytes.count);
+        memcpy(RAW(r_bytes), bytes.src, bytes.count);
+        AMresultFree(encoded);
+
+        SET_VECTOR_ELT(messages, n_out, r_bytes);
+        SET_STRING_ELT(names, n_out, Rf_mkCharLenCE(p->id, (int) p->id_len, CE_UTF8));
+        n_out++;
+    }
+
+    messages = PROTECT(Rf_xlengthgets(messages, n_out));
+    names = PROTECT(Rf_xlengthgets(names, n_out));
+    Rf_namesgets(messages, names);
+
+    UNPROTECT(4);
+    return messages;
+}
+
+/**
+ * List the peers registered with a hub.
+ *
+ * @param hub_ptr External pointer to am_sync_hub
+ * @return Character vector of peer ids, in the order they were added
+ */
+SEXP C_am_sync_hub_peers(SEXP hub_ptr) {
+    am_hub *hub = get_hub(hub_ptr);
+
+    SEXP ids = PROTECT(Rf_allocVector(STRSXP, hub->n_peers));
+    for (size_t i = 0; i < hub->n_peers; i++) {
+        hub_peer *p = hub->peers[i];
+        SET_STRING_ELT(ids, i, Rf_mkCharLenCE(p->id, (int) p->id_len, CE_UTF8));
+    }
+
+    UNPROTECT(1);
+    return ids;
+}
+
+/**
+ * Remove a peer (and its sync state) from a hub.
+ *
+ * @param hub_ptr External pointer to am_sync_hub
+ * @param peer Character string: peer id
+ * @return Logical: TRUE if the peer was registered
+ */
+SEXP C_am_sync_hub_remove(SEXP hub_ptr, SEXP peer) {
+    am_hub *hub = get_hub(hub_ptr);
+    size_t len;
+    const char *id = get_peer_id(peer, &len);
+
+    uint64_t hash = am_hash_bytes(id, len);
+    hub_peer *p = hub_find(hub, id, len, hash);
+    if (!p) {
+        return Rf_ScalarLogical(FALSE);
+    }
+
+    hub_peer **slot = &hub->buckets[hash & (hub->n_buckets - 1)];
+    while (*slot != p) slot = &(*slot)->chain;
+    *slot = p->chain;
+
+    // Preserve insertion order of the remaining peers
+    size_t i = 0;
+    while (hub->peers[i] != p) i++;
+    memmove(&hub->peers[i], &hub->peers[i + 1], (hub->n_peers - i - 1) * sizeof(hub_peer *));
+    hub->n_peers--;
+
+    peer_free(p);
+    return Rf_ScalarLogical(TRUE);
+}
@@ -6,6 +6,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"C_am_save", (DL_FUNC) &C_am_save, 1},
     {"C_am_load", (DL_FUNC) &C_am_load, 1},
     {"C_am_fork", (DL_FUNC) &C_am_fork, 2},
+    {"C_am_save_since", (DL_FUNC) &C_am_save_since, 2},
     {"C_am_merge", (DL_FUNC) &C_am_merge, 2},
     {"C_am_get_actor", (DL_FUNC) &C_am_get_actor, 1},
     {"C_am_get_actor_hex", (DL_FUNC) &C_am_get_actor_hex, 1},
@@ -14,34 +15,76 @@ static const R_CallMethodDef CallEntries[] = {
     {"C_am_rollback", (DL_FUNC) &C_am_rollback, 1},
     // Object operations
     {"C_am_put", (DL_FUNC) &C_am_put, 4},
-    {"C_am_get", (DL_FUNC) &C_am_get, 3},
+    {"C_am_get", (DL_FUNC) &C_am_get, 4},
     {"C_am_delete", (DL_FUNC) &C_am_delete, 3},
-    {"C_am_keys", (DL_FUNC) &C_am_keys, 2},
-    {"C_am_length", (DL_FUNC) &C_am_length, 2},
+    {"C_am_keys", (DL_FUNC) &C_am_keys, 3},
+    {"C_am_length", (DL_FUNC) &C_am_length, 3},
     {"C_am_insert", (DL_FUNC) &C_am_insert, 4},
     {"C_am_text_splice", (DL_FUNC) &C_am_text_splice, 4},
-    {"C_am_text_get", (DL_FUNC) &C_am_text_get, 1},
-    {"C_am_values", (DL_FUNC) &C_am_values, 2},
+    {"C_am_text_get", (DL_FUNC) &C_am_text_get, 2},
+    {"C_am_values", (DL_FUNC) &C_am_values, 3},
     {"C_am_counter_increment", (DL_FUNC) &C_am_counter_increment, 4},
     // Synchronization operations
     {"C_am_sync_state_new", (DL_FUNC) &C_am_sync_state_new, 0},
+    {"C_am_sync_state_save", (DL_FUNC) &C_am_sync_state_save, 1},
+    {"C_am_sync_state_load", (DL_FUNC) &C_am_sync_state_load, 1},
     {"C_am_sync_encode", (DL_FUNC) &C_am_sync_encode, 2},
     {"C_am_sync_decode", (DL_FUNC) &C_am_sync_decode, 3},
+    {"C_am_sync_message_info", (DL_FUNC) &C_am_sync_message_info, 1},
+    {"C_am_sync", (DL_FUNC) &C_am_sync, 2},
     {"C_am_get_heads", (DL_FUNC) &C_am_get_heads, 1},
-    {"C_am_get_changes", (DL_FUNC) &C_am_get_changes, 2},
+    {"C_am_get_changes", (DL_FUNC) &C_am_get_changes, 3},
+    {"C_am_changes_meta", (DL_FUNC) &C_am_changes_meta, 2},
     {"C_am_apply_changes", (DL_FUNC) &C_am_apply_changes, 2},
+    // Multi-peer sync hub
+    {"C_am_sync_hub_new", (DL_FUNC) &C_am_sync_hub_new, 1},
+    {"C_am_sync_hub_receive", (DL_FUNC) &C_am_sync_hub_receive, 3},
+    {"C_am_sync_hub_outbox", (DL_FUNC) &C_am_sync_hub_outbox, 1},
+    {"C_am_sync_hub_peers", (DL_FUNC) &C_am_sync_hub_peers, 1},
+    {"C_am_sync_hub_remove", (DL_FUNC) &C_am_sync_hub_remove, 2},
+    // Batched sync
+    {"C_am_sync_batch_encode", (DL_FUNC) &C_am_sync_batch_encode, 2},
+    {"C_am_sync_batch_decode", (DL_FUNC) &C_am_sync_batch_decode, 3},
+    // Socket transport
+    {"C_am_sync_listen", (DL_FUNC) &C_am_sync_listen, 2},
+    {"C_am_sync_connect", (DL_FUNC) &C_am_sync_connect, 2},
+    {"C_am_sync_poll", (DL_FUNC) &C_am_sync_poll, 2},
+    {"C_am_sync_close", (DL_FUNC) &C_am_sync_close, 1},
+    {"C_am_sync_endpoint_info", (DL_FUNC) &C_am_sync_endpoint_info, 1},
     // Historical queries (phase 6)
     {"C_am_get_last_local_change", (DL_FUNC) &C_am_get_last_local_change, 1},
     {"C_am_get_change_by_hash", (DL_FUNC) &C_am_get_change_by_hash, 2},
     {"C_am_get_changes_added", (DL_FUNC) &C_am_get_changes_added, 2},
+    // Change graph queries
+    {"C_am_is_ancestor", (DL_FUNC) &C_am_is_ancestor, 3},
+    {"C_am_common_ancestors", (DL_FUNC) &C_am_common_ancestors, 3},
+    {"C_am_changes_between", (DL_FUNC) &C_am_changes_between, 3},
+    {"C_am_blame", (DL_FUNC) &C_am_blame, 2},
+    // Patches
+    {"C_am_diff", (DL_FUNC) &C_am_diff, 3},
+    {"C_am_patches_since_last", (DL_FUNC) &C_am_patches_since_last, 1},
+    // Parallel batch operations
+    {"C_am_load_many", (DL_FUNC) &C_am_load_many, 2},
+    {"C_am_save_many", (DL_FUNC) &C_am_save_many, 2},
+    // Pack files
+    {"C_am_pack_write", (DL_FUNC) &C_am_pack_write, 6},
+    {"C_am_pack_read", (DL_FUNC) &C_am_pack_read, 2},
+    {"C_am_pack_index", (DL_FUNC) &C_am_pack_index, 1},
+    {"C_am_pack_compact", (DL_FUNC) &C_am_pack_compact, 2},
+    // Document cache
+    {"C_am_cache_new", (DL_FUNC) &C_am_cache_new, 1},
+    {"C_am_cache_get", (DL_FUNC) &C_am_cache_get, 2},
+    {"C_am_cache_put", (DL_FUNC) &C_am_cache_put, 3},
+    {"C_am_cache_stats", (DL_FUNC) &C_am_cache_stats, 1},
     // Cursor and mark operations
     {"C_am_cursor", (DL_FUNC) &C_am_cursor, 2},
     {"C_am_cursor_position", (DL_FUNC) &C_am_cursor_position, 1},
     {"C_am_mark_create", (DL_FUNC) &C_am_mark_create, 6},
-    {"C_am_marks", (DL_FUNC) &C_am_marks, 1},
+    {"C_am_marks", (DL_FUNC) &C_am_marks, 2},
     {"C_am_marks_at", (DL_FUNC) &C_am_marks_at, 2},
     // Helper functions
     {"C_get_doc_from_objid", (DL_FUNC) &C_get_doc_from_objid, 1},
+    {"C_am_heads_prepare", (DL_FUNC) &C_am_heads_prepare, 2},
     {NULL, NULL, 0}
 };
 
@@ -14,6 +14,8 @@ void am_doc_finalizer(SEXP ext_ptr) {
             doc_wrapper->result = NULL;
         }
         // doc pointer is borrowed from result, freed automatically above
+        am_graph_free(doc_wrapper->graph);
+        if (doc_wrapper->diff_cursor) AMresultFree(doc_wrapper->diff_cursor);
         free(doc_wrapper); 
     }
     R_ClearExternalPtr(ext_ptr);
@@ -116,6 +118,192 @@ SEXP C_get_doc_from_objid(SEXP obj_ptr) {
     return get_doc_from_objid(obj_ptr);
 }
 
+/**
+ * Wrap an AMresult* holding an AMdoc as an am_doc external pointer.
+ * Takes ownership of the result, which must already be checked for
+ * AM_VAL_TYPE_DOC. The result is freed if the wrapper cannot be allocated.
+ *
+ * @param result The AMresult* containing the document (ownership transferred)
+ * @return SEXP external pointer to am_doc (with class c("am_doc", "automerge"))
+ */
+SEXP am_wrap_doc(AMresult *result) {
+    AMitem *item = AMresultItem(result);
+    AMdoc *doc = NULL;
+    AMitemToDoc(item, &doc);
+
+    am_doc *doc_wrapper = malloc(sizeof(am_doc));
+    if (!doc_wrapper) {
+        AMresultFree(result);
+        Rf_error("Failed to allocate memory for document wrapper");
+    }
+    doc_wrapper->result = result;  // Owning result
+    doc_wrapper->doc = doc;        // Borrowed from result
+    doc_wrapper->graph = NULL;
+    doc_wrapper->diff_cursor = NULL;
+
+    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(doc_wrapper, R_NilValue, R_NilValue));
+    R_RegisterCFinalizer(ext_ptr, am_doc_finalizer);
+
+    SEXP class = Rf_allocVector(STRSXP, 2);
+    Rf_classgets(ext_ptr, class);
+    SET_STRING_ELT(class, 0, Rf_mkChar("am_doc"));
+    SET_STRING_ELT(class, 1, Rf_mkChar("automerge"));
+
+    UNPROTECT(1);
+    return ext_ptr;
+}
+
+/**
+ * FNV-1a hash of a byte string, for the C-level hash tables keyed by
+ * strings (document cache, sync hub).
+ */
+uint64_t am_hash_bytes(const void *data, size_t len) {
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Convert an R list of change hashes (as returned by am_get_heads()) into
+ * an AMresult holding one change hash item per head, for passing to
+ * AMfork(), AMgetChanges() and friends via AMresultItems().
+ *
+ * The items are built with AMitemFromChangeHash() and joined with
+ * AMresultCat(). All elements are validated before anything is allocated,
+ * so an invalid list errors without leaking.
+ *
+ * @param heads NULL or a list of raw vectors
+ * @return A new AMresult owned by the caller, or NULL if heads is NULL or
+ *   an empty list
+ */
+AMresult *am_heads_to_result(SEXP heads) {
+    if (heads == R_NilValue) {
+        return NULL;
+    }
+    if (TYPEOF(heads) != VECSXP) {
+        Rf_error("heads must be NULL or a list of raw vectors");
+    }
+
+    R_xlen_t n_heads = XLENGTH(heads);
+    for (R_xlen_t i = 0; i < n_heads; i++) {
+        if (TYPEOF(VECTOR_ELT(heads, i)) != RAWSXP) {
+            Rf_error("All heads must be raw vectors (change hashes)");
+        }
+    }
+    for (R_xlen_t i = 0; i < n_heads; i++) {
+        if (XLENGTH(VECTOR_ELT(heads, i)) != AM_CHANGE_HASH_SIZE) {
+            Rf_error("Invalid change hash at index %lld", (long long) i);
+        }
+    }
+
+    AMresult *out = NULL;
+    for (R_xlen_t i = 0; i < n_heads; i++) {
+        SEXP r_hash = VECTOR_ELT(heads, i);
+        AMbyteSpan hash_span = {
+            .src = RAW(r_hash),
+            .count = (size_t) XLENGTH(r_hash)
+        };
+
+        AMresult *item = AMitemFromChangeHash(hash_span);
+        if (!item || AMresultStatus(item) != AM_STATUS_OK) {
+            if (item) AMresultFree(item);
+            if (out) AMresultFree(out);
+            Rf_error("Invalid change hash at index %lld", (long long) i);
+        }
+        if (!out) {
+            out = item;
+            continue;
+        }
+
+        AMresult *joined = AMresultCat(out, item);
+        AMresultFree(out);
+        AMresultFree(item);
+        if (!joined || AMresultStatus(joined) != AM_STATUS_OK) {
+            if (joined) AMresultFree(joined);
+            Rf_error("Failed to combine change hashes");
+        }
+        out = joined;
+    }
+
+    return out;
+}
+
+/**
+ * Convert the optional heads argument of a read into the AMitems to pass as
+ * its heads, once per call. The items borrow from a result wrapped for R,
+ * which the caller must keep protected while reading.
+ *
+ * heads may also be a result prepared by C_am_heads_prepare(), as held by
+ * am_view_at() views, whose items are used without converting again.
+ *
+ * @param heads NULL, a list of raw vectors or a prepared heads result
+ * @param items Storage for the converted items
+ * @param at Set to items, or to NULL (the current state) if heads is NULL
+ *   or an empty list
+ * @return The wrapped result owning the items, or R_NilValue
+ */
+SEXP am_read_heads(SEXP heads, AMitems *items, AMitems const **at) {
+    *at = NULL;
+    if (TYPEOF(heads) == EXTPTRSXP) {
+        if (!Rf_inherits(heads, "am_heads")) {
+            Rf_error("heads must be NULL or a list of raw vectors");
+        }
+        AMresult *prepared = (AMresult *) R_ExternalPtrAddr(heads);
+        if (!prepared) {
+            Rf_error("Invalid heads pointer (NULL or freed)");
+        }
+        *items = AMresultItems(prepared);
+        *at = items;
+        return heads;
+    }
+    AMresult *result = am_heads_to_result(heads);
+    if (!result) {
+        return R_NilValue;
+    }
+    *items = AMresultItems(result);
+    *at = items;
+    return wrap_am_result(result, R_NilValue);
+}
+
+/**
+ * Convert a list of change hashes into a result that reads can reuse
+ * without converting it again.
+ *
+ * Each hash is looked up with AMgetChangeByHash(), so unknown heads are
+ * rejected without building the change graph index.
+ *
+ * @param doc_ptr External pointer to am_doc the heads belong to
+ * @param heads A non-empty list of raw vectors
+ * @return External pointer to the AMresult holding the heads, with class
+ *   "am_heads" so that am_read_heads() can tell it from other pointers
+ */
+SEXP C_am_heads_prepare(SEXP doc_ptr, SEXP heads) {
+    AMdoc *doc = get_doc(doc_ptr);
+    if (TYPEOF(heads) != VECSXP || XLENGTH(heads) == 0) {
+        Rf_error("heads must be a non-empty list of raw vectors (change hashes)");
+    }
+    SEXP prepared = PROTECT(wrap_am_result(am_heads_to_result(heads), R_NilValue));
+
+    for (R_xlen_t i = 0; i < XLENGTH(heads); i++) {
+        SEXP hash = VECTOR_ELT(heads, i);
+        AMresult *result = AMgetChangeByHash(doc, RAW(hash), (size_t) XLENGTH(hash));
+        AMitem *item = AMresultStatus(result) == AM_STATUS_OK ? AMresultItem(result) : NULL;
+        bool found = item && AMitemValType(item) == AM_VAL_TYPE_CHANGE;
+        AMresultFree(result);
+        if (!found) {
+            Rf_error("Unknown change hash at index %lld", (long long) i);
+        }
+    }
+
+    Rf_classgets(prepared, Rf_mkString("am_heads"));
+    UNPROTECT(1);
+    return prepared;
+}
+
 /**
  * Wrap AMresult* as R external pointer with parent document protection.
  * Uses EXTPTR_PROT to keep parent document alive.
@@ -221,7 +221,7 @@ static void populate_object_from_r_list(AMdoc *doc, const AMobjId *obj_id,
  * Convert AMitem to R value.
  * Handles type conversion from Automerge to R.
  */
-static SEXP am_item_to_r(AMitem *item, SEXP parent_doc_sexp, SEXP parent_result_sexp) {
+SEXP am_item_to_r(AMitem *item, SEXP parent_doc_sexp, SEXP parent_result_sexp) {
     AMvalType val_type = AMitemValType(item);
     SEXP result;
 
@@ -354,28 +354,34 @@ SEXP C_am_put(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos, SEXP value) {
  * @param doc_ptr External pointer to am_doc
  * @param obj_ptr External pointer to AMobjId (or NULL for root)
  * @param key_or_pos For maps: character key. For lists: numeric position (1-based)
+ * @param heads NULL for the current state, or a list of change hashes
  * @return R value
  */
-SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos) {
+SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos, SEXP heads) {
     AMdoc *doc = get_doc(doc_ptr);
     const AMobjId *obj_id = get_objid(obj_ptr);
 
+    AMitems heads_items;
+    AMitems const *at;
+    PROTECT(am_read_heads(heads, &heads_items, &at));
+
     AMresult *result;
 
     if (TYPEOF(key_or_pos) == STRSXP && XLENGTH(key_or_pos) == 1) {
         const char *key_str = CHAR(STRING_ELT(key_or_pos, 0));
         AMbyteSpan key = {.src = (uint8_t const *) key_str, .count = strlen(key_str)};
-        result = AMmapGet(doc, obj_id, key, NULL);
+        result = AMmapGet(doc, obj_id, key, at);
     } else if (TYPEOF(key_or_pos) == REALSXP || TYPEOF(key_or_pos) == INTSXP) {
         if (XLENGTH(key_or_pos) != 1) {
             Rf_error("List position must be a scalar");
         }
         int r_pos = Rf_asInteger(key_or_pos);
         if (r_pos < 1) {
+            UNPROTECT(1);
             return R_NilValue;
         }
         size_t pos = (size_t) (r_pos - 1);  // Convert to 0-based
-        result = AMlistGet(doc, obj_id, pos, NULL);
+        result = AMlistGet(doc, obj_id, pos, at);
     } else {
         Rf_error("Key must be a character string (map) or numeric (list)");
     }
@@ -384,6 +390,7 @@ SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos) {
     if (AMresultStatus(result) != AM_STATUS_OK) {
         if (TYPEOF(key_or_pos) == REALSXP || TYPEOF(key_or_pos) == INTSXP) {
             AMresultFree(result);
+            UNPROTECT(1);
             return R_NilValue;
         }
         CHECK_RESULT(result, AM_VAL_TYPE_VOID);
@@ -392,6 +399,7 @@ SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos) {
     AMitem *item = AMresultItem(result);
     if (!item) {
         AMresultFree(result);
+        UNPROTECT(1);
         return R_NilValue;
     }
 
@@ -399,13 +407,14 @@ SEXP C_am_get(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos) {
     AMvalType val_type = AMitemValType(item);
     if (val_type == AM_VAL_TYPE_VOID || val_type == 0 || val_type == 1) {
         AMresultFree(result);
+        UNPROTECT(1);
         return R_NilValue;
     }
 
     SEXP result_sexp = PROTECT(wrap_am_result(result, doc_ptr));
     SEXP r_value = PROTECT(am_item_to_r(item, doc_ptr, result_sexp));
 
-    UNPROTECT(2);
+    UNPROTECT(3);
     return r_value;
 }
 
@@ -452,13 +461,18 @@ SEXP C_am_delete(SEXP doc_ptr, SEXP obj_ptr, SEXP key_or_pos) {
  *
  * @param doc_ptr External pointer to am_doc
  * @param obj_ptr External pointer to AMobjId (or NULL for root)
+ * @param heads NULL for the current state, or a list of change hashes
  * @return Character vector of keys
  */
-SEXP C_am_keys(SEXP doc_ptr, SEXP obj_ptr) {
+SEXP C_am_keys(SEXP doc_ptr, SEXP obj_ptr, SEXP heads) {
     AMdoc *doc = get_doc(doc_ptr);
     const AMobjId *obj_id = get_objid(obj_ptr);
 
-    AMresult *result = AMkeys(doc, obj_id, NULL);
+    AMitems heads_items;
+    AMitems const *at;
+    PROTECT(am_read_heads(heads, &heads_items, &at));
+
+    AMresult *result = AMkeys(doc, obj_id, at);
     CHECK_RESULT(result, AM_VAL_TYPE_VOID);
 
     AMitems items = AMresultItems(result);
@@ -481,7 +495,7 @@ SEXP C_am_keys(SEXP doc_ptr, SEXP obj_ptr) {
     }
 
     AMresultFree(result);
-    UNPROTECT(1);
+    UNPROTECT(2);
     return keys;
 }
 
@@ -490,13 +504,19 @@ SEXP C_am_keys(SEXP doc_ptr, SEXP obj_ptr) {
  *
  * @param doc_ptr External pointer to am_doc
  * @param obj_ptr External pointer to AMobjId (or NULL for root)
+ * @param heads NULL for the current state, or a list of change hashes
  * @return Integer length
  */
-SEXP C_am_length(SEXP doc_ptr, SEXP obj_ptr) {
+SEXP C_am_length(SEXP doc_ptr, SEXP obj_ptr, SEXP heads) {
     AMdoc *doc = get_doc(doc_ptr);
     const AMobjId *obj_id = get_objid(obj_ptr);
 
-    size_t size = AMobjSize(doc, obj_id, NULL);  // NULL = current heads
+    AMitems heads_items;
+    AMitems const *at;
+    PROTECT(am_read_heads(heads, &heads_items, &at));
+
+    size_t size = AMobjSize(doc, obj_id, at);  // NULL = current heads
+    UNPROTECT(1);
 
     if (size > INT_MAX) {
         return Rf_ScalarReal((double) size);
@@ -584,19 +604,25 @@ SEXP C_am_text_splice(SEXP text_ptr, SEXP pos, SEXP del_count, SEXP text) {
  * Get the full text content from a text object.
  *
  * @param text_ptr External pointer to AMobjId (must be a text object)
+ * @param heads NULL for the current state, or a list of change hashes
  * @return Character string with the full text content
  */
-SEXP C_am_text_get(SEXP text_ptr) {
+SEXP C_am_text_get(SEXP text_ptr, SEXP heads) {
     SEXP doc_ptr = get_doc_from_objid(text_ptr);
     AMdoc *doc = get_doc(doc_ptr);
     const AMobjId *text_obj = get_objid(text_ptr);
 
-    AMresult *result = AMtext(doc, text_obj, NULL);
+    AMitems heads_items;
+    AMitems const *at;
+    PROTECT(am_read_heads(heads, &heads_items, &at));
+
+    AMresult *result = AMtext(doc, text_obj, at);
     CHECK_RESULT(result, AM_VAL_TYPE_VOID);
 
     AMitem *item = AMresultItem(result);
     if (!item) {
         AMresultFree(result);
+        UNPROTECT(1);
         return Rf_mkString("");
     }
 
@@ -609,81 +635,54 @@ SEXP C_am_text_get(SEXP text_ptr) {
     SEXP text_sexp = Rf_ScalarString(Rf_mkCharLen((const char *) text_span.src, text_span.count));
 
     AMresultFree(result);
+    UNPROTECT(1);
     return text_sexp;
 }
 
 /**
  * Get all values from a map or list.
  *
+ * The values are read with a single range query, so the heads are resolved
+ * once per call rather than once per element.
+ *
  * @param doc_ptr External pointer to am_doc
  * @param obj_ptr External pointer to AMobjId (or NULL for root)
+ * @param heads NULL for the current state, or a list of change hashes
  * @return R list of values
  */
-SEXP C_am_values(SEXP doc_ptr, SEXP obj_ptr) {
+SEXP C_am_values(SEXP doc_ptr, SEXP obj_ptr, SEXP heads) {
     AMdoc *doc = get_doc(doc_ptr);
     const AMobjId *obj_id = get_objid(obj_ptr);
 
     AMobjType obj_type = obj_id ? AMobjObjType(doc, obj_id) : AM_OBJ_TYPE_MAP;
     bool is_list = (obj_type == AM_OBJ_TYPE_LIST);
 
-    size_t count = AMobjSize(doc, obj_id, NULL);
-
-    SEXP values = PROTECT(Rf_allocVector(VECSXP, count));
+    AMitems heads_items;
+    AMitems const *at;
+    PROTECT(am_read_heads(heads, &heads_items, &at));
 
+    AMresult *result;
     if (is_list) {
-        for (size_t i = 0; i < count; i++) {
-            AMresult *result = AMlistGet(doc, obj_id, i, NULL);
-            if (AMresultStatus(result) == AM_STATUS_OK) {
-                AMitem *item = AMresultItem(result);
-                if (item) {
-                    SEXP result_sexp = PROTECT(wrap_am_result(result, doc_ptr));
-                    SEXP r_value = PROTECT(am_item_to_r(item, doc_ptr, result_sexp));
-                    SET_VECTOR_ELT(values, i, r_value);
-                    UNPROTECT(2);
-                } else {
-                    AMresultFree(result);
-                }
-            } else {
-                AMresultFree(result);
-            }
-        }
+        result = AMlistRange(doc, obj_id, 0, SIZE_MAX, at);
     } else {
-        AMresult *keys_result = AMkeys(doc, obj_id, NULL);
-        if (AMresultStatus(keys_result) != AM_STATUS_OK) {
-            AMresultFree(keys_result);
-            UNPROTECT(1);
-            Rf_error("Failed to get keys");
-        }
+        AMbyteSpan none = {NULL, 0};
+        result = AMmapRange(doc, obj_id, none, none, at);
+    }
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
 
-        AMitems key_items = AMresultItems(keys_result);
-        AMitem *key_item;
-        size_t i = 0;
-
-        while ((key_item = AMitemsNext(&key_items, 1)) != NULL && i < count) {
-            AMbyteSpan key_span;
-            if (AMitemToStr(key_item, &key_span)) {
-                AMresult *result = AMmapGet(doc, obj_id, key_span, NULL);
-                if (AMresultStatus(result) == AM_STATUS_OK) {
-                    AMitem *item = AMresultItem(result);
-                    if (item) {
-                        SEXP result_sexp = PROTECT(wrap_am_result(result, doc_ptr));
-                        SEXP r_value = PROTECT(am_item_to_r(item, doc_ptr, result_sexp));
-                        SET_VECTOR_ELT(values, i, r_value);
-                        UNPROTECT(2);
-                    } else {
-                        AMresultFree(result);
-                    }
-                } else {
-                    AMresultFree(result);
-                }
-                i++;
-            }
-        }
+    // All values (and any nested object IDs) borrow from the one result
+    SEXP result_sexp = PROTECT(wrap_am_result(result, doc_ptr));
+    AMitems items = AMresultItems(result);
+    size_t count = AMitemsSize(&items);
 
-        AMresultFree(keys_result);
+    SEXP values = PROTECT(Rf_allocVector(VECSXP, count));
+    for (size_t i = 0; i < count; i++) {
+        AMitem *item = AMitemsNext(&items, 1);
+        if (!item) break;
+        SET_VECTOR_ELT(values, i, am_item_to_r(item, doc_ptr, result_sexp));
     }
 
-    UNPROTECT(1);
+    UNPROTECT(3);
     return values;
 }
 
@@ -0,0 +1,612 @@
+#include "automerge.h"
+#include <errno.h>
+#include <stdio.h>
+
+// Pack Files ------------------------------------------------------------------
+//
+// A pack stores many saved documents in one file:
+//
+//   header   "AMPK" | u32 version | u64 index_offset               (16 bytes)
+//   payloads AMsave() bytes, back to back
+//   index    u64 n_entries | n_entries * entry | id string table
+//
+// Each index entry is 64 bytes:
+//
+//   u64 id_offset (into string table) | u32 id_length | u32 reserved |
+//   u64 payload_offset | u64 payload_length | 32-byte heads hash
+//
+// Entries are sorted by id (bytewise), so a single document is located by
+// binary search reading O(log n) entries. All integers are little-endian.
+//
+// Appending writes new payloads and a merged index after the current index,
+// and only then rewrites the header to point at it, so a pack remains
+// readable if a write is interrupted. Superseded payloads and indexes are
+// left in place until am_pack_compact() rewrites the file. A new pack (and
+// am_pack_compact()) is written to a temporary file in the same directory
+// and renamed over the target, so an existing file is never truncated.
+
+#ifdef _WIN32
+#define pack_fseek _fseeki64
+#define pack_ftell _ftelli64
+#else
+#define pack_fseek fseeko
+#define pack_ftell ftello
+#endif
+
+#define PACK_MAGIC "AMPK"
+#define PACK_VERSION 1
+#define PACK_HEADER_SIZE 16
+#define PACK_ENTRY_SIZE 64
+#define PACK_HASH_SIZE 32
+#define PACK_COPY_BUFFER 65536
+
+typedef struct {
+    const uint8_t *id;
+    size_t id_len;
+    uint64_t offset;
+    uint64_t length;
+    uint8_t heads[PACK_HASH_SIZE];
+} pack_entry;
+
+// Fully loaded index (entries point into `strtab`)
+typedef struct {
+    pack_entry *entries;
+    size_t n;
+    uint8_t *strtab;
+    uint64_t index_offset;
+} pack_index;
+
+static void put_u32(uint8_t *buf, uint32_t x) {
+    for (int i = 0; i < 4; i++) buf[i] = (uint8_t) (x >> (8 * i));
+}
+
+static void put_u64(uint8_t *buf, uint64_t x) {
+    for (int i = 0; i < 8; i++) buf[i] = (uint8_t) (x >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+    uint32_t x = 0;
+    for (int i = 3; i >= 0; i--) x = (x << 8) | buf[i];
+    return x;
+}
+
+static uint64_t get_u64(const uint8_t *buf) {
+    uint64_t x = 0;
+    for (int i = 7; i >= 0; i--) x = (x << 8) | buf[i];
+    return x;
+}
+
+static int compare_ids(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const pack_entry *x = a, *y = b;
+    return compare_ids(x->id, x->id_len, y->id, y->id_len);
+}
+
+static int read_at(FILE *f, uint64_t offset, void *buf, size_t count) {
+    if (pack_fseek(f, (int64_t) offset, SEEK_SET) != 0) return 0;
+    return fread(buf, 1, count, f) == count;
+}
+
+static void decode_entry(const uint8_t *buf, pack_entry *entry, uint64_t *id_offset) {
+    *id_offset = get_u64(buf);
+    entry->id_len = get_u32(buf + 8);
+    entry->offset = get_u64(buf + 16);
+    entry->length = get_u64(buf + 24);
+    memcpy(entry->heads, buf + 32, PACK_HASH_SIZE);
+}
+
+/**
+ * Read and validate the pack header.
+ *
+ * @return Index offset, or 0 if the header is invalid
+ */
+static uint64_t read_header(FILE *f) {
+    uint8_t header[PACK_HEADER_SIZE];
+    if (!read_at(f, 0, header, PACK_HEADER_SIZE)) return 0;
+    if (memcmp(header, PACK_MAGIC, 4) != 0) return 0;
+    if (get_u32(header + 4) != PACK_VERSION) return 0;
+    return get_u64(header + 8);
+}
+
+static void free_index(pack_index *index) {
+    free(index->entries);
+    free(index->strtab);
+    index->entries = NULL;
+    index->strtab = NULL;
+    index->n = 0;
+}
+
+/**
+ * Load the full index of a pack.
+ *
+ * @return NULL on success, or a static error message
+ */
+static const char *read_index(FILE *f, pack_index *index) {
+    index->entries = NULL;
+    index->strtab = NULL;
+    index->n = 0;
+
+    index->index_offset = read_header(f);
+    if (index->index_offset == 0) return "not an automerge pack file";
+
+    uint8_t buf[PACK_ENTRY_SIZE];
+    if (!read_at(f, index->index_offset, buf, 8)) return "truncated pack index";
+    uint64_t n = get_u64(buf);
+    uint64_t strtab_offset = index->index_offset + 8 + n * PACK_ENTRY_SIZE;
+
+    if (pack_fseek(f, 0, SEEK_END) != 0) return "cannot seek in pack file";
+    uint64_t file_size = (uint64_t) pack_ftell(f);
+    if (strtab_offset > file_size) return "truncated pack index";
+    size_t strtab_len = (size_t) (file_size - strtab_offset);
+
+    index->entries = malloc((n > 0 ? n : 1) * sizeof(pack_entry));
+    index->strtab = malloc(strtab_len > 0 ? strtab_len : 1);
+    if (!index->entries || !index->strtab) {
+        free_index(index);
+        return "out of memory reading pack index";
+    }
+    index->n = (size_t) n;
+
+    if (pack_fseek(f, (int64_t) (index->index_offset + 8), SEEK_SET) != 0) {
+        free_index(index);
+        return "cannot seek in pack file";
+    }
+    for (size_t i = 0; i < index->n; i++) {
+        uint64_t id_offset;
+        if (fread(buf, 1, PACK_ENTRY_SIZE, f) != PACK_ENTRY_SIZE) {
+            free_index(index);
+            return "truncated pack index";
+        }
+        decode_entry(buf, &index->entries[i], &id_offset);
+        if (id_offset + index->entries[i].id_len > strtab_len) {
+            free_index(index);
+            return "corrupt pack index";
+        }
+        index->entries[i].id = index->strtab + id_offset;
+    }
+    if (fread(index->strtab, 1, strtab_len, f) != strtab_len) {
+        free_index(index);
+        return "truncated pack index";
+    }
+
+    return NULL;
+}
+
+/**
+ * Write an index (entries must be sorted) at the current file position,
+ * then point the header at it.
+ *
+ * @return 1 on success, 0 on I/O error
+ */
+static int write_index(FILE *f, uint64_t index_offset, const pack_entry *entries, size_t n) {
+    uint8_t buf[PACK_ENTRY_SIZE];
+
+    if (pack_fseek(f, (int64_t) index_offset, SEEK_SET) != 0) return 0;
+    put_u64(buf, (uint64_t) n);
+    if (fwrite(buf, 1, 8, f) != 8) return 0;
+
+    uint64_t id_offset = 0;
+    for (size_t i = 0; i < n; i++) {
+        put_u64(buf, id_offset);
+        put_u32(buf + 8, (uint32_t) entries[i].id_len);
+        put_u32(buf + 12, 0);
+        put_u64(buf + 16, entries[i].offset);
+        put_u64(buf + 24, entries[i].length);
+        memcpy(buf + 32, entries[i].heads, PACK_HASH_SIZE);
+        if (fwrite(buf, 1, PACK_ENTRY_SIZE, f) != PACK_ENTRY_SIZE) return 0;
+        id_offset += entries[i].id_len;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (fwrite(entries[i].id, 1, entries[i].id_len, f) != entries[i].id_len) return 0;
+    }
+    if (fflush(f) != 0) return 0;
+
+    uint8_t header[PACK_HEADER_SIZE];
+    memcpy(header, PACK_MAGIC, 4);
+    put_u32(header + 4, PACK_VERSION);
+    put_u64(header + 8, index_offset);
+    if (pack_fseek(f, 0, SEEK_SET) != 0) return 0;
+    if (fwrite(header, 1, PACK_HEADER_SIZE, f) != PACK_HEADER_SIZE) return 0;
+    return fflush(f) == 0;
+}
+
+static const char *get_path(SEXP path) {
+    if (TYPEOF(path) != STRSXP || XLENGTH(path) != 1 || STRING_ELT(path, 0) == NA_STRING) {
+        Rf_error("path must be a single character string");
+    }
+    return CHAR(STRING_ELT(path, 0));
+}
+
+static SEXP hash_to_hex(const uint8_t *hash) {
+    static const char digits[] = "0123456789abcdef";
+    char hex[PACK_HASH_SIZE * 2];
+    for (int i = 0; i < PACK_HASH_SIZE; i++) {
+        hex[2 * i] = digits[hash[i] >> 4];
+        hex[2 * i + 1] = digits[hash[i] & 0x0f];
+    }
+    return Rf_mkCharLen(hex, PACK_HASH_SIZE * 2);
+}
+
+// Rename a fully written temporary file over `file`; removes `tmp_file` on
+// failure
+static int replace_file(const char *tmp_file, const char *file) {
+#ifdef _WIN32
+    remove(file);  // rename() does not replace existing files on Windows
+#endif
+    if (rename(tmp_file, file) != 0) {
+        remove(tmp_file);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Write documents to a pack file.
+ *
+ * Payloads are written first; the index is written after them and the
+ * header updated last. With `append`, entries whose id already exists in
+ * the pack are replaced.
+ *
+ * @param path Character string: pack file path
+ * @param ids Character vector of unique document ids
+ * @param payloads List of raw vectors (saved documents)
+ * @param heads List of heads (each a list of raw change hashes)
+ * @param append Logical: add to an existing pack instead of replacing it
+ * @param tmp_path Character string: temporary file in the same directory,
+ *   used when a new pack is written
+ * @return R_NilValue
+ */
+SEXP C_am_pack_write(SEXP path, SEXP ids, SEXP payloads, SEXP heads, SEXP append,
+                     SEXP tmp_path) {
+    const char *file = get_path(path);
+    const char *tmp_file = get_path(tmp_path);
+
+    if (TYPEOF(ids) != STRSXP) {
+        Rf_error("ids must be a character vector");
+    }
+    R_xlen_t n = XLENGTH(ids);
+    if (TYPEOF(payloads) != VECSXP || XLENGTH(payloads) != n ||
+        TYPEOF(heads) != VECSXP || XLENGTH(heads) != n) {
+        Rf_error("ids, payloads and heads must have the same length");
+    }
+
+    pack_entry *new_entries = (pack_entry *) R_alloc(n > 0 ? n : 1, sizeof(pack_entry));
+    for (R_xlen_t i = 0; i < n; i++) {
+        SEXP id = STRING_ELT(ids, i);
+        if (id == NA_STRING || LENGTH(id) == 0) {
+            Rf_error("Document ids must be non-empty strings");
+        }
+        if (TYPEOF(VECTOR_ELT(payloads, i)) != RAWSXP) {
+            Rf_error("All payloads must be raw vectors");
+        }
+        new_entries[i].id = (const uint8_t *) CHAR(id);
+        new_entries[i].id_len = (size_t) LENGTH(id);
+        new_entries[i].offset = (uint64_t) i;  // Payload index until written
+
+        // XOR of the head hashes: order-independent, and equal to the head
+        // itself in the common single-head case
+        memset(new_entries[i].heads, 0, PACK_HASH_SIZE);
+        SEXP doc_heads = VECTOR_ELT(heads, i);
+        if (TYPEOF(doc_heads) != VECSXP) {
+            Rf_error("heads must be a list of change hash lists");
+        }
+        for (R_xlen_t j = 0; j < XLENGTH(doc_heads); j++) {
+            SEXP hash = VECTOR_ELT(doc_heads, j);
+            if (TYPEOF(hash) != RAWSXP || XLENGTH(hash) != PACK_HASH_SIZE) {
+                Rf_error("Each head must be a 32-byte raw vector");
+            }
+            for (int k = 0; k < PACK_HASH_SIZE; k++) {
+                new_entries[i].heads[k] ^= RAW(hash)[k];
+            }
+        }
+    }
+
+    qsort(new_entries, n, sizeof(pack_entry), compare_entries);
+    for (R_xlen_t i = 1; i < n; i++) {
+        if (compare_entries(&new_entries[i - 1], &new_entries[i]) == 0) {
+            Rf_error("Duplicate document id: %.*s",
+                     (int) new_entries[i].id_len, (const char *) new_entries[i].id);
+        }
+    }
+
+    pack_index old = {NULL, 0, NULL, 0};
+    FILE *f = NULL;
+    int fresh = 0;
+    if (Rf_asLogical(append) == TRUE) {
+        errno = 0;
+        f = fopen(file, "r+b");
+        // Only a missing file starts a new pack; anything else (permissions,
+        // a directory, ...) must not fall through to truncating it
+        if (!f && errno != ENOENT) {
+            Rf_error("Cannot open '%s' for appending: %s", file, strerror(errno));
+        }
+    }
+    if (f) {
+        const char *err = read_index(f, &old);
+        if (err) {
+            fclose(f);
+            Rf_error("Cannot append to '%s': %s", file, err);
+        }
+    } else {
+        // A new pack is built in the temporary file and only renamed over
+        // `file` once complete, so the previous contents survive a failure
+        fresh = 1;
+        f = fopen(tmp_file, "w+b");
+        if (!f) {
+            Rf_error("Cannot open '%s' for writing", tmp_file);
+        }
+        uint8_t header[PACK_HEADER_SIZE] = {0};
+        if (fwrite(header, 1, PACK_HEADER_SIZE, f) != PACK_HEADER_SIZE) {
+            fclose(f);
+            remove(tmp_file);
+            Rf_error("Failed to write pack header to '%s'", tmp_file);
+        }
+    }
+
+    // Write payloads after everything currently in the file
+    int ok = pack_fseek(f, 0, SEEK_END) == 0;
+    uint64_t offset = ok ? (uint64_t) pack_ftell(f) : 0;
+    for (R_xlen_t i = 0; ok && i < n; i++) {
+        SEXP payload = VECTOR_ELT(payloads, (R_xlen_t) new_entries[i].offset);
+        size_t len = (size_t) XLENGTH(payload);
+        ok = fwrite(RAW(payload), 1, len, f) == len;
+        new_entries[i].offset = offset;
+        new_entries[i].length = (uint64_t) len;
+        offset += len;
+    }
+
+    // Merge the sorted old and new entries; new entries win on equal ids
+    pack_entry *merged = ok ? malloc((old.n + n + 1) * sizeof(pack_entry)) : NULL;
+    size_t n_merged = 0;
+    if (merged) {
+        size_t i = 0, j = 0;
+        while (i < old.n || j < (size_t) n) {
+            int cmp = i == old.n ? 1 : j == (size_t) n ? -1 :
+                      compare_entries(&old.entries[i], &new_entries[j]);
+            if (cmp < 0) {
+                merged[n_merged++] = old.entries[i++];
+            } else {
+                if (cmp == 0) i++;
+                merged[n_merged++] = new_entries[j++];
+            }
+        }
+        ok = write_index(f, offset, merged, n_merged);
+    } else {
+        ok = 0;
+    }
+
+    free(merged);
+    free_index(&old);
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) {
+        if (fresh) remove(tmp_file);
+        Rf_error("Failed to write pack file '%s'", file);
+    }
+    if (fresh && !replace_file(tmp_file, file)) {
+        Rf_error("Failed to replace '%s' with new pack", file);
+    }
+
+    return R_NilValue;
+}
+
+/**
+ * Load a single document from a pack file.
+ *
+ * Only the header, O(log n) index entries and ids, and the document's own
+ * payload are read.
+ *
+ * @param path Character string: pack file path
+ * @param id Character string: document id
+ * @return External pointer to am_doc, or NULL if the id is not in the pack
+ */
+SEXP C_am_pack_read(SEXP path, SEXP id) {
+    const char *file = get_path(path);
+    if (TYPEOF(id) != STRSXP || XLENGTH(id) != 1 || STRING_ELT(id, 0) == NA_STRING) {
+        Rf_error("id must be a single character string");
+    }
+    const uint8_t *key = (const uint8_t *) CHAR(STRING_ELT(id, 0));
+    size_t key_len = (size_t) LENGTH(STRING_ELT(id, 0));
+
+    FILE *f = fopen(file, "rb");
+    if (!f) {
+        Rf_error("Cannot open '%s'", file);
+    }
+
+    const char *err = NULL;
+    uint8_t buf[PACK_ENTRY_SIZE];
+    uint8_t *probe = malloc(key_len + 1);
+    uint8_t *payload = NULL;
+    pack_entry found;
+    int have = 0;
+
+    uint64_t index_offset = read_header(f);
+    if (!probe) {
+        err = "out of memory";
+    } else if (index_offset == 0) {
+        err = "not an automerge pack file";
+    } else if (!read_at(f, index_offset, buf, 8)) {
+        err = "truncated pack index";
+    } else {
+        uint64_t n = get_u64(buf);
+        uint64_t strtab = index_offset + 8 + n * PACK_ENTRY_SIZE;
+        uint64_t lo = 0, hi = n;
+        while (lo < hi && !err) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            pack_entry entry;
+            uint64_t id_offset;
+            if (!read_at(f, index_offset + 8 + mid * PACK_ENTRY_SIZE, buf, PACK_ENTRY_SIZE)) {
+                err = "truncated pack index";
+                break;
+            }
+            decode_entry(buf, &entry, &id_offset);
+
+            // Only the first key_len + 1 bytes are needed to order the ids
+            size_t cmp_len = entry.id_len < key_len + 1 ? entry.id_len : key_len + 1;
+            if (!read_at(f, strtab + id_offset, probe, cmp_len)) {
+                err = "truncated pack index";
+                break;
+            }
+            int cmp = compare_ids(probe, cmp_len, key, key_len);
+            if (cmp == 0) {
+                found = entry;
+                have = 1;
+                break;
+            } else if (cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+    }
+
+    if (have && !err) {
+        payload = malloc(found.length > 0 ? (size_t) found.length : 1);
+        if (!payload) {
+            err = "out of memory";
+        } else if (!read_at(f, found.offset, payload, (size_t) found.length)) {
+            err = "truncated document payload";
+        }
+    }
+
+    free(probe);
+    fclose(f);
+    if (err) {
+        free(payload);
+        Rf_error("Failed to read pack file '%s': %s", file, err);
+    }
+    if (!have) {
+        return R_NilValue;
+    }
+
+    AMresult *result = AMload(payload, (size_t) found.length);
+    free(payload);
+    CHECK_RESULT(result, AM_VAL_TYPE_DOC);
+
+    return am_wrap_doc(result);
+}
+
+/**
+ * List the contents of a pack file.
+ *
+ * @param path Character string: pack file path
+ * @return List with elements id, offset, length and heads (hex), sorted by id
+ */
+SEXP C_am_pack_index(SEXP path) {
+    const char *file = get_path(path);
+    FILE *f = fopen(file, "rb");
+    if (!f) {
+        Rf_error("Cannot open '%s'", file);
+    }
+
+    pack_index index;
+    const char *err = read_index(f, &index);
+    fclose(f);
+    if (err) {
+        Rf_error("Failed to read pack file '%s': %s", file, err);
+    }
+
+    SEXP ids = PROTECT(Rf_allocVector(STRSXP, index.n));
+    SEXP offsets = PROTECT(Rf_allocVector(REALSXP, index.n));
+    SEXP lengths = PROTECT(Rf_allocVector(REALSXP, index.n));
+    SEXP heads = PROTECT(Rf_allocVector(STRSXP, index.n));
+    for (size_t i = 0; i < index.n; i++) {
+        pack_entry *e = &index.entries[i];
+        SET_STRING_ELT(ids, i, Rf_mkCharLenCE((const char *) e->id, (int) e->id_len, CE_UTF8));
+        REAL(offsets)[i] = (double) e->offset;
+        REAL(lengths)[i] = (double) e->length;
+        SET_STRING_ELT(heads, i, hash_to_hex(e->heads));
+    }
+    free_index(&index);
+
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, 4));
+    SET_VECTOR_ELT(out, 0, ids);
+    SET_VECTOR_ELT(out, 1, offsets);
+    SET_VECTOR_ELT(out, 2, lengths);
+    SET_VECTOR_ELT(out, 3, heads);
+
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, 4));
+    SET_STRING_ELT(names, 0, Rf_mkChar("id"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("offset"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("length"));
+    SET_STRING_ELT(names, 3, Rf_mkChar("heads"));
+    Rf_namesgets(out, names);
+
+    UNPROTECT(6);
+    return out;
+}
+
+/**
+ * Rewrite a pack file keeping only live payloads.
+ *
+ * The compacted pack is written to `tmp_path` and then renamed over `path`.
+ *
+ * @param path Character string: pack file path
+ * @param tmp_path Character string: temporary file in the same directory
+ * @return Number of bytes reclaimed (double)
+ */
+SEXP C_am_pack_compact(SEXP path, SEXP tmp_path) {
+    const char *file = get_path(path);
+    const char *tmp_file = get_path(tmp_path);
+
+    FILE *in = fopen(file, "rb");
+    if (!in) {
+        Rf_error("Cannot open '%s'", file);
+    }
+    pack_index index;
+    const char *err = read_index(in, &index);
+    if (err) {
+        fclose(in);
+        Rf_error("Failed to read pack file '%s': %s", file, err);
+    }
+    int ok = pack_fseek(in, 0, SEEK_END) == 0;
+    uint64_t old_size = ok ? (uint64_t) pack_ftell(in) : 0;
+
+    FILE *out = fopen(tmp_file, "w+b");
+    uint8_t *buf = malloc(PACK_COPY_BUFFER);
+    if (!out || !buf) {
+        free(buf);
+        if (out) fclose(out);
+        fclose(in);
+        free_index(&index);
+        Rf_error("Cannot open '%s' for writing", tmp_file);
+    }
+
+    uint8_t header[PACK_HEADER_SIZE] = {0};
+    ok = ok && fwrite(header, 1, PACK_HEADER_SIZE, out) == PACK_HEADER_SIZE;
+    uint64_t offset = PACK_HEADER_SIZE;
+    for (size_t i = 0; ok && i < index.n; i++) {
+        pack_entry *e = &index.entries[i];
+        ok = pack_fseek(in, (int64_t) e->offset, SEEK_SET) == 0;
+        uint64_t remaining = e->length;
+        while (ok && remaining > 0) {
+            size_t chunk = remaining < PACK_COPY_BUFFER ? (size_t) remaining : PACK_COPY_BUFFER;
+            ok = fread(buf, 1, chunk, in) == chunk && fwrite(buf, 1, chunk, out) == chunk;
+            remaining -= chunk;
+        }
+        e->offset = offset;
+        offset += e->length;
+    }
+    ok = ok && write_index(out, offset, index.entries, index.n);
+    ok = ok && pack_fseek(out, 0, SEEK_END) == 0;
+    uint64_t new_size = ok ? (uint64_t) pack_ftell(out) : 0;
+
+    free(buf);
+    free_index(&index);
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) {
+        remove(tmp_file);
+        Rf_error("Failed to write compacted pack '%s'", tmp_file);
+    }
+
+    if (!replace_file(tmp_file, file)) {
+        Rf_error("Failed to replace '%s' with compacted pack", file);
+    }
+
+    return Rf_ScalarReal((double) (old_size - new_size));
+}
@@ -0,0 +1,406 @@
+#include "automerge.h"
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Worker Pool -----------------------------------------------------------------
+
+/**
+ * Shared state for a batch of independent tasks.
+ *
+ * Workers claim task indices from a mutex-protected counter until the batch
+ * is exhausted. Task functions must not call into the R API: they run on
+ * native threads while the main R thread is blocked in pthread_join().
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t n_tasks;
+    void (*run)(void *ctx, size_t i);
+    void *ctx;
+} am_pool;
+
+static void *am_pool_worker(void *arg) {
+    am_pool *pool = (am_pool *) arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->n_tasks) break;
+        pool->run(pool->ctx, i);
+    }
+    return NULL;
+}
+
+/**
+ * Number of online processors, used when no thread count is given.
+ */
+static int default_thread_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int n = (int) info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n > 0 ? (int) n : 1;
+}
+
+/**
+ * Resolve the R `threads` argument to a positive thread count.
+ *
+ * @param threads R integer/numeric scalar, or NULL for the processor count
+ * @param n_tasks Number of tasks (no more threads than tasks are started)
+ * @return Number of threads to use (>= 1)
+ */
+static int resolve_threads(SEXP threads, size_t n_tasks) {
+    int n;
+    if (threads == R_NilValue) {
+        n = default_thread_count();
+    } else {
+        if ((TYPEOF(threads) != INTSXP && TYPEOF(threads) != REALSXP) ||
+            XLENGTH(threads) != 1) {
+            Rf_error("threads must be NULL or a single positive number");
+        }
+        n = Rf_asInteger(threads);
+        if (n == NA_INTEGER || n < 1) {
+            Rf_error("threads must be NULL or a single positive number");
+        }
+    }
+    if ((size_t) n > n_tasks) n = (int) n_tasks;
+    return n < 1 ? 1 : n;
+}
+
+/**
+ * Run `run(ctx, i)` for i in [0, n_tasks) on up to `n_threads` threads.
+ * The calling thread participates, so thread creation failures only reduce
+ * parallelism rather than losing work.
+ */
+static void am_pool_run(size_t n_tasks, int n_threads,
+                        void (*run)(void *ctx, size_t i), void *ctx) {
+    am_pool pool = {.next = 0, .n_tasks = n_tasks, .run = run, .ctx = ctx};
+    pthread_mutex_init(&pool.lock, NULL);
+
+    int n_workers = n_threads - 1;
+    pthread_t *workers = n_workers > 0 ? malloc(n_workers * sizeof(pthread_t)) : NULL;
+    int started = 0;
+    if (workers) {
+        for (; started < n_workers; started++) {
+            if (pthread_create(&workers[started], NULL, am_pool_worker, &pool) != 0) break;
+        }
+    }
+
+    am_pool_worker(&pool);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    pthread_mutex_destroy(&pool.lock);
+}
+
+/**
+ * Copy the error message of a failed AMresult into a malloc'd C string.
+ * Safe to call from worker threads (no R API).
+ */
+static char *copy_result_error(AMresult *result) {
+    AMbyteSpan err_span = AMresultError(result);
+    size_t msg_size = err_span.count < MAX_ERROR_MSG_SIZE ?
+                      err_span.count : MAX_ERROR_MSG_SIZE;
+    char *msg = malloc(msg_size + 1);
+    if (msg) {
+        memcpy(msg, err_span.src, msg_size);
+        msg[msg_size] = '\0';
+    }
+    return msg;
+}
+
+// Parallel Load ---------------------------------------------------------------
+
+typedef struct {
+    const uint8_t *src;  // Raw input (borrowed from R vector), or NULL
+    size_t count;
+    const char *path;    // File path (borrowed from CHARSXP), or NULL
+    AMresult *result;    // Owned until wrapped on the main thread
+    char *error;         // malloc'd error message, or NULL on success
+} am_load_task;
+
+static char *read_file(const char *path, size_t *count) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    char *buf = NULL;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long size = ftell(f);
+        if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+            buf = malloc(size > 0 ? (size_t) size : 1);
+            if (buf && fread(buf, 1, (size_t) size, f) != (size_t) size) {
+                free(buf);
+                buf = NULL;
+            }
+            *count = (size_t) size;
+        }
+    }
+    fclose(f);
+    return buf;
+}
+
+static void load_task_run(void *ctx, size_t i) {
+    am_load_task *task = (am_load_task *) ctx + i;
+
+    char *file_buf = NULL;
+    const uint8_t *src = task->src;
+    size_t count = task->count;
+    if (task->path) {
+        file_buf = read_file(task->path, &count);
+        if (!file_buf) {
+            const char *prefix = "cannot read file ";
+            task->error = malloc(strlen(prefix) + strlen(task->path) + 1);
+            if (task->error) {
+                strcpy(task->error, prefix);
+                strcat(task->error, task->path);
+            }
+            return;
+        }
+        src = (const uint8_t *) file_buf;
+    }
+
+    AMresult *result = AMload(src, count);
+    free(file_buf);
+
+    if (AMresultStatus(result) != AM_STATUS_OK) {
+        task->error = copy_result_error(result);
+        AMresultFree(result);
+        return;
+    }
+    task->result = result;
+}
+
+// The finished tasks of a batch, wrapped for R on the main thread
+typedef struct {
+    void *tasks;
+    R_xlen_t n;
+    SEXP out;
+} am_task_batch;
+
+static SEXP load_wrap_run(void *data) {
+    am_task_batch *batch = (am_task_batch *) data;
+    am_load_task *tasks = (am_load_task *) batch->tasks;
+    for (R_xlen_t i = 0; i < batch->n; i++) {
+        AMresult *result = tasks[i].result;
+        tasks[i].result = NULL;
+        if (AMitemValType(AMresultItem(result)) != AM_VAL_TYPE_DOC) {
+            AMresultFree(result);
+            Rf_error("Failed to load document %lld: unexpected result type",
+                     (long long) i + 1);
+        }
+        SET_VECTOR_ELT(batch->out, i, am_wrap_doc(result));
+    }
+    return batch->out;
+}
+
+// Free the results not yet handed to R, whether wrapping finished or not
+static void load_wrap_cleanup(void *data) {
+    am_task_batch *batch = (am_task_batch *) data;
+    am_load_task *tasks = (am_load_task *) batch->tasks;
+    for (R_xlen_t i = 0; i < batch->n; i++) {
+        if (tasks[i].result) AMresultFree(tasks[i].result);
+        tasks[i].result = NULL;
+    }
+}
+
+/**
+ * Load many documents in parallel.
+ *
+ * Inputs are resolved to byte spans (or file paths) on the main thread, then
+ * decoded with AMload() on a native worker pool. The resulting AMresults are
+ * wrapped as am_doc external pointers on the main thread once all workers
+ * have finished, under R_ExecWithCleanup() so that an R error part way
+ * through frees the results not yet wrapped.
+ *
+ * @param data List of raw vectors and/or file paths, or a character vector
+ *             of file paths
+ * @param threads Number of threads, or NULL for the processor count
+ * @return List of am_doc external pointers (names preserved)
+ */
+SEXP C_am_load_many(SEXP data, SEXP threads) {
+    if (TYPEOF(data) != VECSXP && TYPEOF(data) != STRSXP) {
+        Rf_error("data must be a list of raw vectors or file paths");
+    }
+
+    R_xlen_t n = XLENGTH(data);
+    SEXP docs = PROTECT(Rf_allocVector(VECSXP, n));
+    Rf_namesgets(docs, Rf_getAttrib(data, R_NamesSymbol));
+    if (n == 0) {
+        UNPROTECT(1);
+        return docs;
+    }
+
+    am_load_task *tasks = (am_load_task *) R_alloc(n, sizeof(am_load_task));
+    for (R_xlen_t i = 0; i < n; i++) {
+        tasks[i] = (am_load_task) {NULL, 0, NULL, NULL, NULL};
+        if (TYPEOF(data) == STRSXP) {
+            if (STRING_ELT(data, i) == NA_STRING) {
+                Rf_error("Element %lld of data must be a raw vector or a file path",
+                         (long long) i + 1);
+            }
+            tasks[i].path = CHAR(STRING_ELT(data, i));
+            continue;
+        }
+        SEXP elt = VECTOR_ELT(data, i);
+        if (TYPEOF(elt) == RAWSXP) {
+            tasks[i].src = RAW(elt);
+            tasks[i].count = (size_t) XLENGTH(elt);
+        } else if (TYPEOF(elt) == STRSXP && XLENGTH(elt) == 1 &&
+                   STRING_ELT(elt, 0) != NA_STRING) {
+            tasks[i].path = CHAR(STRING_ELT(elt, 0));
+        } else {
+            Rf_error("Element %lld of data must be a raw vector or a file path",
+                     (long long) i + 1);
+        }
+    }
+
+    am_pool_run((size_t) n, resolve_threads(threads, (size_t) n), load_task_run, tasks);
+
+    R_xlen_t failed = -1;
+    for (R_xlen_t i = 0; i < n; i++) {
+        if (!tasks[i].result && failed < 0) failed = i;
+    }
+    if (failed >= 0) {
+        char msg[MAX_ERROR_MSG_SIZE + 1];
+        snprintf(msg, sizeof(msg), "%s",
+                 tasks[failed].error ? tasks[failed].error : "out of memory");
+        for (R_xlen_t i = 0; i < n; i++) {
+            if (tasks[i].result) AMresultFree(tasks[i].result);
+            free(tasks[i].error);
+        }
+        Rf_error("Failed to load document %lld: %s", (long long) failed + 1, msg);
+    }
+
+    am_task_batch batch = {tasks, n, docs};
+    R_ExecWithCleanup(load_wrap_run, &batch, load_wrap_cleanup, &batch);
+
+    UNPROTECT(1);
+    return docs;
+}
+
+// Parallel Save ---------------------------------------------------------------
+
+typedef struct {
+    AMdoc *doc;
+    size_t owner;        // Index of the task that saves this document
+    AMresult *result;
+    char *error;
+} am_save_task;
+
+typedef struct {
+    AMdoc *doc;
+    size_t index;
+} am_doc_index;
+
+static int compare_doc_index(const void *a, const void *b) {
+    const am_doc_index *x = a, *y = b;
+    if (x->doc != y->doc) return x->doc < y->doc ? -1 : 1;
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+static void save_task_run(void *ctx, size_t i) {
+    am_save_task *task = (am_save_task *) ctx + i;
+    if (task->owner != i) return;  // Duplicate of another task's document
+
+    AMresult *result = AMsave(task->doc);
+    if (AMresultStatus(result) != AM_STATUS_OK) {
+        task->error = copy_result_error(result);
+        AMresultFree(result);
+        return;
+    }
+    task->result = result;
+}
+
+static SEXP save_wrap_run(void *data) {
+    am_task_batch *batch = (am_task_batch *) data;
+    am_save_task *tasks = (am_save_task *) batch->tasks;
+    for (R_xlen_t i = 0; i < batch->n; i++) {
+        AMresult *result = tasks[tasks[i].owner].result;
+        AMbyteSpan bytes;
+        AMitemToBytes(AMresultItem(result), &bytes);
+
+        SEXP r_bytes = Rf_allocVector(RAWSXP, bytes.count);
+        memcpy(RAW(r_bytes), bytes.src, bytes.count);
+        SET_VECTOR_ELT(batch->out, i, r_bytes);
+    }
+    return batch->out;
+}
+
+static void save_wrap_cleanup(void *data) {
+    am_task_batch *batch = (am_task_batch *) data;
+    am_save_task *tasks = (am_save_task *) batch->tasks;
+    for (R_xlen_t i = 0; i < batch->n; i++) {
+        if (tasks[i].result) AMresultFree(tasks[i].result);
+        tasks[i].result = NULL;
+    }
+}
+
+/**
+ * Save many documents in parallel.
+ *
+ * AMsave() needs exclusive access to its document, so a document that
+ * appears more than once in `docs` is saved once and its bytes reused. The
+ * bytes are copied into R vectors under R_ExecWithCleanup(), so the saved
+ * results are freed even if an allocation fails.
+ *
+ * @param docs List of am_doc external pointers
+ * @param threads Number of threads, or NULL for the processor count
+ * @return List of raw vectors (names preserved)
+ */
+SEXP C_am_save_many(SEXP docs, SEXP threads) {
+    if (TYPEOF(docs) != VECSXP) {
+        Rf_error("docs must be a list of Automerge documents");
+    }
+
+    R_xlen_t n = XLENGTH(docs);
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, n));
+    Rf_namesgets(out, Rf_getAttrib(docs, R_NamesSymbol));
+    if (n == 0) {
+        UNPROTECT(1);
+        return out;
+    }
+
+    am_save_task *tasks = (am_save_task *) R_alloc(n, sizeof(am_save_task));
+    am_doc_index *order = (am_doc_index *) R_alloc(n, sizeof(am_doc_index));
+    for (R_xlen_t i = 0; i < n; i++) {
+        AMdoc *doc = get_doc(VECTOR_ELT(docs, i));
+        tasks[i] = (am_save_task) {doc, (size_t) i, NULL, NULL};
+        order[i] = (am_doc_index) {doc, (size_t) i};
+    }
+
+    qsort(order, n, sizeof(am_doc_index), compare_doc_index);
+    for (R_xlen_t i = 1; i < n; i++) {
+        if (order[i].doc == order[i - 1].doc) {
+            tasks[order[i].index].owner = tasks[order[i - 1].index].owner;
+        }
+    }
+
+    am_pool_run((size_t) n, resolve_threads(threads, (size_t) n), save_task_run, tasks);
+
+    for (R_xlen_t i = 0; i < n; i++) {
+        if (tasks[i].owner == (size_t) i && !tasks[i].result) {
+            char msg[MAX_ERROR_MSG_SIZE + 1];
+            snprintf(msg, sizeof(msg), "%s",
+                     tasks[i].error ? tasks[i].error : "out of memory");
+            for (R_xlen_t j = 0; j < n; j++) {
+                if (tasks[j].result) AMresultFree(tasks[j].result);
+                free(tasks[j].error);
+            }
+            Rf_error("Failed to save document %lld: %s", (long long) i + 1, msg);
+        }
+    }
+
+    am_task_batch batch = {tasks, n, out};
+    R_ExecWithCleanup(save_wrap_run, &batch, save_wrap_cleanup, &batch);
+
+    UNPROTECT(1);
+    return out;
+}
@@ -3,17 +3,11 @@
 // Synchronization Functions ------------------------------------------------
 
 /**
- * Create a new sync state for managing synchronization with a peer.
- *
- * IMPORTANT: Sync state is document-independent. The document is passed
- * separately to am_sync_encode() and am_sync_decode() at call time.
- *
- * @return External pointer to am_syncstate structure (with class "am_syncstate")
+ * Wrap an AMresult* holding an AMsyncState as an am_syncstate external
+ * pointer. Takes ownership of the result, which must already be checked
+ * for AM_VAL_TYPE_SYNC_STATE.
  */
-SEXP C_am_sync_state_new(void) {
-    AMresult *result = AMsyncStateInit();
-    CHECK_RESULT(result, AM_VAL_TYPE_SYNC_STATE);
-
+static SEXP wrap_syncstate(AMresult *result) {
     AMitem *item = AMresultItem(result);
     AMsyncState *state = NULL;
     AMitemToSyncState(item, &state);
@@ -36,6 +30,70 @@ SEXP C_am_sync_state_new(void) {
     return ext_ptr;
 }
 
+/**
+ * Create a new sync state for managing synchronization with a peer.
+ *
+ * IMPORTANT: Sync state is document-independent. The document is passed
+ * separately to am_sync_encode() and am_sync_decode() at call time.
+ *
+ * @return External pointer to am_syncstate structure (with class "am_syncstate")
+ */
+SEXP C_am_sync_state_new(void) {
+    AMresult *result = AMsyncStateInit();
+    CHECK_RESULT(result, AM_VAL_TYPE_SYNC_STATE);
+    return wrap_syncstate(result);
+}
+
+/**
+ * Serialize a sync state for storage.
+ *
+ * Wraps AMsyncStateEncode(sync_state). Only the state that remains valid
+ * across connections (the heads both peers are known to share) is encoded.
+ *
+ * @param sync_state_ptr External pointer to am_syncstate
+ * @return Raw vector containing the encoded sync state
+ */
+SEXP C_am_sync_state_save(SEXP sync_state_ptr) {
+    if (TYPEOF(sync_state_ptr) != EXTPTRSXP) {
+        Rf_error("Expected external pointer for sync state");
+    }
+    am_syncstate *state_wrapper = (am_syncstate *) R_ExternalPtrAddr(sync_state_ptr);
+    if (!state_wrapper || !state_wrapper->state) {
+        Rf_error("Invalid sync state pointer (NULL or freed)");
+    }
+
+    AMresult *result = AMsyncStateEncode(state_wrapper->state);
+    CHECK_RESULT(result, AM_VAL_TYPE_BYTES);
+
+    AMbyteSpan bytes;
+    AMitemToBytes(AMresultItem(result), &bytes);
+
+    SEXP r_bytes = PROTECT(Rf_allocVector(RAWSXP, bytes.count));
+    memcpy(RAW(r_bytes), bytes.src, bytes.count);
+
+    AMresultFree(result);
+    UNPROTECT(1);
+    return r_bytes;
+}
+
+/**
+ * Restore a sync state saved with C_am_sync_state_save().
+ *
+ * Wraps AMsyncStateDecode(src, count).
+ *
+ * @param data Raw vector containing an encoded sync state
+ * @return External pointer to am_syncstate structure (with class "am_syncstate")
+ */
+SEXP C_am_sync_state_load(SEXP data) {
+    if (TYPEOF(data) != RAWSXP) {
+        Rf_error("data must be a raw vector");
+    }
+
+    AMresult *result = AMsyncStateDecode(RAW(data), (size_t) XLENGTH(data));
+    CHECK_RESULT(result, AM_VAL_TYPE_SYNC_STATE);
+    return wrap_syncstate(result);
+}
+
 /**
  * Generate a sync message to send to a peer.
  *
@@ -137,6 +195,300 @@ SEXP C_am_sync_decode(SEXP doc_ptr, SEXP sync_state_ptr, SEXP message) {
     return doc_ptr;
 }
 
+// Sync message header reader. Walks the wire format (see Message::parse in
+// the core's sync.rs) without copying change chunks or building bloom
+// filters:
+//
+//   u8 type (0x42 / 0x43)
+//   heads:   uleb n, n x 32-byte hash
+//   needs:   uleb n, n x 32-byte hash
+//   haves:   uleb n, n x (uleb m, m x hash, uleb len, bloom bytes)
+//   changes: uleb n, n x (uleb len, chunk bytes)
+//   [capabilities]
+//
+// Each length-delimited block holds storage chunks (see Chunk::parse in the
+// core's storage/chunk.rs):
+//
+//   4-byte magic, 4-byte checksum, u8 type, uleb len, len data bytes
+//
+// A V1 message sends one change chunk per block. A V2 message puts every
+// change in a single block, or sends a whole document chunk (from save())
+// to a peer that has nothing yet.
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} msg_reader;
+
+static uint64_t read_uleb(msg_reader *r) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) Rf_error("Invalid sync message: unexpected end of input");
+        uint8_t byte = *r->p++;
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    Rf_error("Invalid sync message: malformed length");
+    return 0;
+}
+
+static const uint8_t *read_bytes(msg_reader *r, uint64_t len) {
+    if (len > (uint64_t) (r->end - r->p)) {
+        Rf_error("Invalid sync message: unexpected end of input");
+    }
+    const uint8_t *start = r->p;
+    r->p += len;
+    return start;
+}
+
+// Read a length-prefixed run of change hashes into a list of raw vectors
+static SEXP read_hashes(msg_reader *r) {
+    uint64_t n = read_uleb(r);
+    if (n > (uint64_t) (r->end - r->p) / AM_CHANGE_HASH_SIZE) {
+        Rf_error("Invalid sync message: unexpected end of input");
+    }
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, (R_xlen_t) n));
+    for (uint64_t i = 0; i < n; i++) {
+        SEXP hash = Rf_allocVector(RAWSXP, AM_CHANGE_HASH_SIZE);
+        memcpy(RAW(hash), read_bytes(r, AM_CHANGE_HASH_SIZE), AM_CHANGE_HASH_SIZE);
+        SET_VECTOR_ELT(out, (R_xlen_t) i, hash);
+    }
+    UNPROTECT(1);
+    return out;
+}
+
+static const uint8_t chunk_magic[4] = {0x85, 0x6f, 0x4a, 0x83};
+
+// Walk the chunk headers of one block, counting change chunks (plain or
+// compressed). Document and bundle chunks pack many changes into columns
+// that would have to be decoded to count, so they only set *document.
+static void count_chunks(const uint8_t *p, uint64_t len, double *n_changes, int *document) {
+    msg_reader c = {p, p + len};
+    while (c.p < c.end) {
+        if (memcmp(read_bytes(&c, 4), chunk_magic, 4) != 0) {
+            Rf_error("Invalid sync message: bad chunk header");
+        }
+        read_bytes(&c, 4);
+        uint8_t type = *read_bytes(&c, 1);
+        read_bytes(&c, read_uleb(&c));
+        switch (type) {
+        case 1:
+        case 2:
+            *n_changes += 1;
+            break;
+        case 0:
+        case 3:
+            *document = 1;
+            break;
+        default:
+            Rf_error("Invalid sync message: unknown chunk type %d", type);
+        }
+    }
+}
+
+/**
+ * Inspect a sync message without decoding it.
+ *
+ * Only the headers are read: change chunks are skipped over (counted and
+ * sized) and bloom filters are measured but not parsed, so no document is
+ * needed.
+ *
+ * @param message Raw vector containing an encoded sync message
+ * @return Named list: version, heads, needs, haves, n_changes, document,
+ *   change_bytes, bloom_bytes, bytes
+ */
+SEXP C_am_sync_message_info(SEXP message) {
+    if (TYPEOF(message) != RAWSXP) {
+        Rf_error("message must be a raw vector");
+    }
+
+    msg_reader r = {RAW(message), RAW(message) + XLENGTH(message)};
+    if (r.p >= r.end) {
+        Rf_error("Invalid sync message: empty input");
+    }
+    uint8_t type = *r.p++;
+    if (type != 0x42 && type != 0x43) {
+        Rf_error("Invalid sync message: unknown message type 0x%02x", type);
+    }
+
+    const char *names[] = {"version", "heads", "needs", "haves", "n_changes",
+                           "document", "change_bytes", "bloom_bytes", "bytes", ""};
+    SEXP out = PROTECT(Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(out, 0, Rf_ScalarInteger(type == 0x42 ? 1 : 2));
+    SET_VECTOR_ELT(out, 1, read_hashes(&r));
+    SET_VECTOR_ELT(out, 2, read_hashes(&r));
+
+    uint64_t n_haves = read_uleb(&r);
+    if (n_haves > (uint64_t) (r.end - r.p)) {
+        Rf_error("Invalid sync message: unexpected end of input");
+    }
+    SEXP haves = PROTECT(Rf_allocVector(VECSXP, (R_xlen_t) n_haves));
+    SET_VECTOR_ELT(out, 3, haves);
+    double bloom_bytes = 0;
+    for (uint64_t i = 0; i < n_haves; i++) {
+        SET_VECTOR_ELT(haves, (R_xlen_t) i, read_hashes(&r));
+        uint64_t len = read_uleb(&r);
+        read_bytes(&r, len);
+        bloom_bytes += (double) len;
+    }
+
+    uint64_t n_blocks = read_uleb(&r);
+    double n_changes = 0, change_bytes = 0;
+    int document = 0;
+    for (uint64_t i = 0; i < n_blocks; i++) {
+        uint64_t len = read_uleb(&r);
+        count_chunks(read_bytes(&r, len), len, &n_changes, &document);
+        change_bytes += (double) len;
+    }
+
+    SET_VECTOR_ELT(out, 4, Rf_ScalarReal(n_changes));
+    SET_VECTOR_ELT(out, 5, Rf_ScalarLogical(document));
+    SET_VECTOR_ELT(out, 6, Rf_ScalarReal(change_bytes));
+    SET_VECTOR_ELT(out, 7, Rf_ScalarReal(bloom_bytes));
+    SET_VECTOR_ELT(out, 8, Rf_ScalarReal((double) XLENGTH(message)));
+
+    UNPROTECT(2);
+    return out;
+}
+
+/**
+ * Sum the number and raw size of changes a document gained since `heads`.
+ *
+ * @return 1 on success, 0 if AMgetChanges() failed
+ */
+static int count_new_changes(AMdoc *doc, AMresult *heads, double *changes, double *bytes) {
+    AMitems heads_items = AMresultItems(heads);
+    AMresult *result = AMgetChanges(doc, &heads_items);
+    if (AMresultStatus(result) != AM_STATUS_OK) {
+        AMresultFree(result);
+        return 0;
+    }
+    AMitems items = AMresultItems(result);
+    AMitem *item = NULL;
+    while ((item = AMitemsNext(&items, 1)) != NULL) {
+        AMchange *change = NULL;
+        AMitemToChange(item, &change);
+        *changes += 1;
+        *bytes += (double) AMchangeRawBytes(change).count;
+    }
+    AMresultFree(result);
+    return 1;
+}
+
+/**
+ * Copy the error message of a failed AMresult into `buf` (which must hold
+ * MAX_ERROR_MSG_SIZE + 1 bytes).
+ */
+static void copy_error(AMresult *result, char *buf) {
+    AMbyteSpan err_span = AMresultError(result);
+    size_t msg_size = err_span.count < MAX_ERROR_MSG_SIZE ?
+                      err_span.count : MAX_ERROR_MSG_SIZE;
+    memcpy(buf, err_span.src, msg_size);
+    buf[msg_size] = '\0';
+}
+
+/**
+ * Synchronize two in-process documents until both converge.
+ *
+ * Runs the same exchange as the sync protocol over a network, but passes
+ * each AMsyncMessage directly to the other side instead of encoding it to
+ * bytes and decoding it again.
+ *
+ * @param doc1_ptr External pointer to am_doc
+ * @param doc2_ptr External pointer to am_doc
+ * @return Number of rounds (double), with attributes "messages", "changes"
+ *   (changes received by either document) and "bytes" (their raw size)
+ */
+SEXP C_am_sync(SEXP doc1_ptr, SEXP doc2_ptr) {
+    AMdoc *doc1 = get_doc(doc1_ptr);
+    AMdoc *doc2 = get_doc(doc2_ptr);
+
+    // Results owned for the whole exchange, freed together before returning
+    enum { STATE1, STATE2, HEADS1, HEADS2, N_OWNED };
+    AMresult *owned[N_OWNED] = {
+        AMsyncStateInit(), AMsyncStateInit(), AMgetHeads(doc1), AMgetHeads(doc2)
+    };
+    char error_msg[MAX_ERROR_MSG_SIZE + 1] = "";
+    int failed = 0;
+
+    for (int i = 0; i < N_OWNED && !failed; i++) {
+        if (AMresultStatus(owned[i]) != AM_STATUS_OK) {
+            copy_error(owned[i], error_msg);
+            failed = 1;
+        }
+    }
+
+    AMsyncState *state1 = NULL, *state2 = NULL;
+    if (!failed) {
+        AMitemToSyncState(AMresultItem(owned[STATE1]), &state1);
+        AMitemToSyncState(AMresultItem(owned[STATE2]), &state2);
+    }
+
+    double rounds = 0, messages = 0;
+    int done = failed;
+    while (!done) {
+        rounds++;
+
+        // Generate both messages before delivering either, as a pair of
+        // networked peers would
+        AMresult *gen[2] = {
+            AMgenerateSyncMessage(doc1, state1), AMgenerateSyncMessage(doc2, state2)
+        };
+        AMdoc *recv_doc[2] = {doc2, doc1};
+        AMsyncState *recv_state[2] = {state2, state1};
+        int sent = 0;
+
+        for (int i = 0; i < 2 && !failed; i++) {
+            if (AMresultStatus(gen[i]) != AM_STATUS_OK) {
+                copy_error(gen[i], error_msg);
+                failed = 1;
+            }
+        }
+        for (int i = 0; i < 2 && !failed; i++) {
+            AMitem *item = AMresultItem(gen[i]);
+            if (AMitemValType(item) != AM_VAL_TYPE_SYNC_MESSAGE) continue;
+
+            AMsyncMessage const *msg = NULL;
+            AMitemToSyncMessage(item, &msg);
+            AMresult *received = AMreceiveSyncMessage(recv_doc[i], recv_state[i], msg);
+            if (AMresultStatus(received) != AM_STATUS_OK) {
+                copy_error(received, error_msg);
+                failed = 1;
+            }
+            AMresultFree(received);
+            messages++;
+            sent++;
+        }
+
+        AMresultFree(gen[0]);
+        AMresultFree(gen[1]);
+        done = failed || sent == 0;
+    }
+
+    double changes = 0, bytes = 0;
+    if (!failed &&
+        (!count_new_changes(doc1, owned[HEADS1], &changes, &bytes) ||
+         !count_new_changes(doc2, owned[HEADS2], &changes, &bytes))) {
+        snprintf(error_msg, sizeof(error_msg), "failed to count synced changes");
+        failed = 1;
+    }
+
+    for (int i = 0; i < N_OWNED; i++) {
+        AMresultFree(owned[i]);
+    }
+    if (failed) {
+        Rf_error("Sync failed after %.0f rounds: %s", rounds, error_msg);
+    }
+
+    SEXP out = PROTECT(Rf_ScalarReal(rounds));
+    Rf_setAttrib(out, Rf_install("messages"), Rf_ScalarReal(messages));
+    Rf_setAttrib(out, Rf_install("changes"), Rf_ScalarReal(changes));
+    Rf_setAttrib(out, Rf_install("bytes"), Rf_ScalarReal(bytes));
+
+    UNPROTECT(1);
+    return out;
+}
+
 // Change Tracking and History Functions -------------------------------------
 
 /**
@@ -188,51 +540,27 @@ SEXP C_am_get_heads(SEXP doc_ptr) {
  *
  * Wraps AMgetChanges(doc, heads).
  *
+ * With buffer = TRUE the changes are returned as one raw vector holding the
+ * serialized changes back to back, with an "offsets" attribute giving the
+ * (0-based) start of each change. Change chunks are self-delimiting, so the
+ * buffer can be passed to AMloadIncremental() as is.
+ *
  * @param doc_ptr External pointer to am_doc
  * @param heads List of raw vectors (change hashes), or NULL for all changes
- * @return List of raw vectors (serialized changes)
+ * @param buffer Logical scalar: return a single buffer instead of a list
+ * @return List of raw vectors (serialized changes), or a raw vector
  */
-SEXP C_am_get_changes(SEXP doc_ptr, SEXP heads) {
+SEXP C_am_get_changes(SEXP doc_ptr, SEXP heads, SEXP buffer) {
     AMdoc *doc = get_doc(doc_ptr);
 
+    AMresult *heads_result = am_heads_to_result(heads);
     AMresult *result = NULL;
-
-    if (heads == R_NilValue) {
-        result = AMgetChanges(doc, NULL);
+    if (heads_result) {
+        AMitems heads_items = AMresultItems(heads_result);
+        result = AMgetChanges(doc, &heads_items);
+        AMresultFree(heads_result);
     } else {
-        if (TYPEOF(heads) != VECSXP) {
-            Rf_error("heads must be NULL or a list of raw vectors");
-        }
-
-        R_xlen_t heads_count = Rf_xlength(heads);
-        if (heads_count == 0) {
-            // Empty list treated same as NULL
-            result = AMgetChanges(doc, NULL);
-        } else if (heads_count == 1) {
-            SEXP r_hash = VECTOR_ELT(heads, 0);
-            if (TYPEOF(r_hash) != RAWSXP) {
-                Rf_error("Each head must be a raw vector");
-            }
-
-            AMbyteSpan hash_span = {
-                .src = RAW(r_hash),
-                .count = (size_t)Rf_xlength(r_hash)
-            };
-
-            AMresult *heads_result = AMitemFromChangeHash(hash_span);
-            if (!heads_result || AMresultStatus(heads_result) != AM_STATUS_OK) {
-                if (heads_result) AMresultFree(heads_result);
-                Rf_error("Invalid change hash");
-            }
-
-            AMitems heads_items = AMresultItems(heads_result);
-            result = AMgetChanges(doc, &heads_items);
-
-            AMresultFree(heads_result);
-        } else {
-            // Multiple heads not yet implemented
-            Rf_error("Getting changes since multiple specific heads not yet implemented (use single head or NULL)");
-        }
+        result = AMgetChanges(doc, NULL);
     }
 
     if (AMresultStatus(result) != AM_STATUS_OK) {
@@ -242,6 +570,39 @@ SEXP C_am_get_changes(SEXP doc_ptr, SEXP heads) {
     AMitems items = AMresultItems(result);
     size_t count = AMitemsSize(&items);
 
+    if (Rf_asLogical(buffer) == TRUE) {
+        // Size the buffer first so the changes are copied exactly once
+        size_t total = 0;
+        AMitems sizing = items;
+        AMitem *item = NULL;
+        while ((item = AMitemsNext(&sizing, 1)) != NULL) {
+            AMchange *change = NULL;
+            AMitemToChange(item, &change);
+            total += AMchangeRawBytes(change).count;
+        }
+
+        SEXP out = PROTECT(Rf_allocVector(RAWSXP, (R_xlen_t) total));
+        SEXP offsets = PROTECT(Rf_allocVector(REALSXP, (R_xlen_t) count));
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            item = AMitemsNext(&items, 1);
+            if (!item) break;
+
+            AMchange *change = NULL;
+            AMitemToChange(item, &change);
+            AMbyteSpan bytes = AMchangeRawBytes(change);
+
+            memcpy(RAW(out) + offset, bytes.src, bytes.count);
+            REAL(offsets)[i] = (double) offset;
+            offset += bytes.count;
+        }
+        Rf_setAttrib(out, Rf_install("offsets"), offsets);
+
+        AMresultFree(result);
+        UNPROTECT(2);
+        return out;
+    }
+
     if (count == 0) {
         AMresultFree(result);
         return Rf_allocVector(VECSXP, 0);
@@ -269,50 +630,439 @@ SEXP C_am_get_changes(SEXP doc_ptr, SEXP heads) {
 }
 
 /**
- * Apply changes from another peer to this document.
+ * Get the metadata of changes since specified heads as columns.
  *
- * Uses AMloadIncremental() to apply each serialized change.
+ * Wraps AMgetChanges(doc, heads) but reads each change's header fields in
+ * place rather than copying its serialized bytes into R. The columns are
+ * allocated up front and filled in one pass.
  *
  * @param doc_ptr External pointer to am_doc
- * @param changes List of raw vectors (serialized changes)
- * @return The document pointer (invisibly, for chaining)
+ * @param heads List of raw vectors (change hashes), or NULL for all changes
+ * @return Named list of columns: hash, actor, seq, start_op, max_op, time,
+ *   message, n_deps
  */
-SEXP C_am_apply_changes(SEXP doc_ptr, SEXP changes) {
+SEXP C_am_changes_meta(SEXP doc_ptr, SEXP heads) {
+    static const char digits[] = "0123456789abcdef";
     AMdoc *doc = get_doc(doc_ptr);
 
-    if (TYPEOF(changes) != VECSXP) {
-        Rf_error("changes must be a list of raw vectors");
+    AMresult *heads_result = am_heads_to_result(heads);
+    AMresult *result = NULL;
+    if (heads_result) {
+        AMitems heads_items = AMresultItems(heads_result);
+        result = AMgetChanges(doc, &heads_items);
+        AMresultFree(heads_result);
+    } else {
+        result = AMgetChanges(doc, NULL);
     }
 
-    R_xlen_t n_changes = XLENGTH(changes);
-    if (n_changes == 0) {
-        return doc_ptr;
+    if (AMresultStatus(result) != AM_STATUS_OK) {
+        CHECK_RESULT(result, AM_VAL_TYPE_CHANGE);
     }
 
-    for (R_xlen_t i = 0; i < n_changes; i++) {
-        SEXP change_bytes = VECTOR_ELT(changes, i);
-        if (TYPEOF(change_bytes) != RAWSXP) {
-            Rf_error("All changes must be raw vectors (got type %d at index %lld)",
-                    TYPEOF(change_bytes), (long long) i);
+    AMitems items = AMresultItems(result);
+    R_xlen_t count = (R_xlen_t) AMitemsSize(&items);
+
+    const char *names[] = {"hash", "actor", "seq", "start_op", "max_op",
+                           "time", "message", "n_deps", ""};
+    SEXP out = PROTECT(Rf_mkNamed(VECSXP, names));
+    SEXP hash = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 0, hash);
+    SEXP actor = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 1, actor);
+    SEXP seq = Rf_allocVector(REALSXP, count);
+    SET_VECTOR_ELT(out, 2, seq);
+    SEXP start_op = Rf_allocVector(REALSXP, count);
+    SET_VECTOR_ELT(out, 3, start_op);
+    SEXP max_op = Rf_allocVector(REALSXP, count);
+    SET_VECTOR_ELT(out, 4, max_op);
+    SEXP time = Rf_allocVector(REALSXP, count);
+    SET_VECTOR_ELT(out, 5, time);
+    SEXP message = Rf_allocVector(STRSXP, count);
+    SET_VECTOR_ELT(out, 6, message);
+    SEXP n_deps = Rf_allocVector(INTSXP, count);
+    SET_VECTOR_ELT(out, 7, n_deps);
+
+    SEXP classes = Rf_allocVector(STRSXP, 2);
+    Rf_classgets(time, classes);
+    SET_STRING_ELT(classes, 0, Rf_mkChar("POSIXct"));
+    SET_STRING_ELT(classes, 1, Rf_mkChar("POSIXt"));
+
+    // Consecutive changes usually share an actor, so reuse its CHARSXP
+    SEXP last_actor = NA_STRING;
+    uint8_t last_actor_bytes[64];
+    size_t last_actor_len = 0;
+
+    for (R_xlen_t i = 0; i < count; i++) {
+        AMitem *item = AMitemsNext(&items, 1);
+        if (!item) break;
+
+        AMchange *change = NULL;
+        AMitemToChange(item, &change);
+
+        AMbyteSpan h = AMchangeHash(change);
+        char hex[64];
+        size_t hex_len = h.count < 32 ? h.count : 32;
+        for (size_t j = 0; j < hex_len; j++) {
+            hex[2 * j] = digits[h.src[j] >> 4];
+            hex[2 * j + 1] = digits[h.src[j] & 0x0f];
         }
+        SET_STRING_ELT(hash, i, Rf_mkCharLen(hex, (int) (2 * hex_len)));
 
-        AMresult *result = AMloadIncremental(doc, RAW(change_bytes), (size_t) XLENGTH(change_bytes));
+        AMresult *actor_result = AMchangeActorId(change);
+        if (AMresultStatus(actor_result) != AM_STATUS_OK) {
+            AMresultFree(result);
+            CHECK_RESULT(actor_result, AM_VAL_TYPE_ACTOR_ID);
+        }
+        AMactorId const *actor_id = NULL;
+        AMitemToActorId(AMresultItem(actor_result), &actor_id);
+        AMbyteSpan actor_bytes = AMactorIdBytes(actor_id);
+        if (last_actor == NA_STRING || actor_bytes.count != last_actor_len ||
+            memcmp(actor_bytes.src, last_actor_bytes, last_actor_len) != 0) {
+            AMbyteSpan actor_str = AMactorIdStr(actor_id);
+            last_actor = Rf_mkCharLenCE((const char *) actor_str.src,
+                                        (int) actor_str.count, CE_UTF8);
+            if (actor_bytes.count <= sizeof(last_actor_bytes)) {
+                memcpy(last_actor_bytes, actor_bytes.src, actor_bytes.count);
+                last_actor_len = actor_bytes.count;
+            } else {
+                last_actor_len = SIZE_MAX;
+            }
+        }
+        SET_STRING_ELT(actor, i, last_actor);
+        AMresultFree(actor_result);
 
-        // Provide context about which change failed
+        REAL(seq)[i] = (double) AMchangeSeq(change);
+        REAL(start_op)[i] = (double) AMchangeStartOp(change);
+        REAL(max_op)[i] = (double) AMchangeMaxOp(change);
+        // Milliseconds to seconds for POSIXct
+        REAL(time)[i] = (double) AMchangeTime(change) / 1000.0;
+
+        AMbyteSpan msg = AMchangeMessage(change);
+        SET_STRING_ELT(message, i, msg.count == 0 ? NA_STRING :
+                       Rf_mkCharLenCE((const char *) msg.src, (int) msg.count, CE_UTF8));
+
+        AMresult *deps_result = AMchangeDeps(change);
+        if (AMresultStatus(deps_result) != AM_STATUS_OK) {
+            AMresultFree(result);
+            CHECK_RESULT(deps_result, AM_VAL_TYPE_VOID);
+        }
+        AMitems deps = AMresultItems(deps_result);
+        INTEGER(n_deps)[i] = (int) AMitemsSize(&deps);
+        AMresultFree(deps_result);
+    }
+
+    AMresultFree(result);
+    UNPROTECT(1);
+    return out;
+}
+
+/**
+ * Check that `len` bytes at `p` are a run of whole storage chunks (see the
+ * chunk layout above C_am_sync_message_info()). Only the headers are read;
+ * see chunk_status() for the contents.
+ *
+ * @return NULL if the framing is valid, otherwise a description of the fault
+ */
+static const char *check_chunks(const uint8_t *p, size_t len) {
+    const uint8_t *end = p + len;
+    while (p < end) {
+        if ((size_t) (end - p) < 9) {
+            return "unable to parse chunk: failed to parse header: unexpected end of input";
+        }
+        if (memcmp(p, chunk_magic, 4) != 0) {
+            return "unable to parse chunk: failed to parse header: Invalid magic bytes";
+        }
+        if (p[8] > 3) {
+            return "unable to parse chunk: failed to parse header: unknown chunk type";
+        }
+        p += 9;
+        uint64_t data_len = 0;
+        int shift = 0;
+        for (;;) {
+            if (p >= end || shift >= 64) {
+                return "unable to parse chunk: failed to parse header: invalid length";
+            }
+            uint8_t byte = *p++;
+            data_len |= (uint64_t) (byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) break;
+        }
+        if (data_len > (uint64_t) (end - p)) {
+            return "unable to parse chunk: unexpected end of input";
+        }
+        p += data_len;
+    }
+    return NULL;
+}
+
+// Size of the chunk at `p`, whose framing has been checked by check_chunks()
+static size_t chunk_size(const uint8_t *p) {
+    size_t header = 9;
+    uint64_t data_len = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = p[header++];
+        data_len |= (uint64_t) (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return header + (size_t) data_len;
+}
+
+// Read a uleb at *p, advancing it; 0 if the input ends first
+static int take_uleb(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return 1;
+    }
+    return 0;
+}
+
+// Whether the change with this hash is in the document
+static int has_change(AMdoc *doc, const uint8_t *hash, size_t count) {
+    AMresult *result = AMgetChangeByHash(doc, hash, count);
+    int found = AMresultStatus(result) == AM_STATUS_OK &&
+                AMitemValType(AMresultItem(result)) == AM_VAL_TYPE_CHANGE;
+    AMresultFree(result);
+    return found;
+}
+
+/**
+ * Check whether a single chunk is valid and has been loaded into `doc`.
+ *
+ * A change chunk is parsed with AMchangeFromBytes() and its checksum
+ * compared with its hash (which AMchangeFromBytes() does not do itself).
+ * A document chunk counts as loaded once all the heads listed in its header
+ * are in `doc`. Bundles are not produced by this package and are taken on
+ * trust.
+ *
+ * @param err Receives the fault (MAX_ERROR_MSG_SIZE + 1 bytes) if invalid
+ * @return 1 if loaded, 0 if valid but not in the document (for example a
+ *   change waiting for its dependencies), -1 if invalid
+ */
+static int chunk_status(AMdoc *doc, const uint8_t *chunk, size_t len, char *err) {
+    uint8_t type = chunk[8];
+    if (type == 1 || type == 2) {
+        AMresult *result = AMchangeFromBytes(chunk, len);
         if (AMresultStatus(result) != AM_STATUS_OK) {
-            AMbyteSpan error_span = AMresultError(result);
-            size_t msg_size = error_span.count < MAX_ERROR_MSG_SIZE ?
-                              error_span.count : MAX_ERROR_MSG_SIZE;
-            char error_msg[MAX_ERROR_MSG_SIZE + 1];
-            memcpy(error_msg, error_span.src, msg_size);
-            error_msg[msg_size] = '\0';
+            copy_error(result, err);
+            AMresultFree(result);
+            return -1;
+        }
+        AMchange *change = NULL;
+        AMitemToChange(AMresultItem(result), &change);
+        AMbyteSpan hash = AMchangeHash(change);
+        if (hash.count < 4 || memcmp(hash.src, chunk + 4, 4) != 0) {
+            AMresultFree(result);
+            snprintf(err, MAX_ERROR_MSG_SIZE + 1, "change checksum does not match its contents");
+            return -1;
+        }
+        int found = has_change(doc, hash.src, hash.count);
+        AMresultFree(result);
+        return found;
+    }
+    if (type == 0) {
+        // Data: actors (uleb n, n x (uleb len, bytes)), heads (uleb n, n x hash)
+        const uint8_t *p = chunk + 9;
+        const uint8_t *end = chunk + len;
+        uint64_t data_len, n_actors, actor_len, n_heads;
+        take_uleb(&p, end, &data_len);  // Checked by check_chunks()
+        if (!take_uleb(&p, end, &n_actors)) goto bad_document;
+        for (uint64_t i = 0; i < n_actors; i++) {
+            if (!take_uleb(&p, end, &actor_len) || actor_len > (uint64_t) (end - p)) {
+                goto bad_document;
+            }
+            p += actor_len;
+        }
+        if (!take_uleb(&p, end, &n_heads) ||
+            n_heads > (uint64_t) (end - p) / AM_CHANGE_HASH_SIZE) {
+            goto bad_document;
+        }
+        for (uint64_t i = 0; i < n_heads; i++) {
+            if (!has_change(doc, p + i * AM_CHANGE_HASH_SIZE, AM_CHANGE_HASH_SIZE)) return 0;
+        }
+        return 1;
+    bad_document:
+        snprintf(err, MAX_ERROR_MSG_SIZE + 1, "invalid document chunk header");
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Apply changes one AMloadIncremental() call at a time, checking each chunk
+ * afterwards (see chunk_status()) and stopping with an error naming the
+ * first change that fails. Change i is the len_i bytes at src_i.
+ */
+static void apply_changes_each(AMdoc *doc, R_xlen_t n, const uint8_t **src, const size_t *len) {
+    char error_msg[MAX_ERROR_MSG_SIZE + 1];
+    for (R_xlen_t i = 0; i < n; i++) {
+        AMresult *result = AMloadIncremental(doc, src[i], len[i]);
 
+        // Provide context about which change failed
+        if (AMresultStatus(result) != AM_STATUS_OK) {
+            copy_error(result, error_msg);
             AMresultFree(result);
             Rf_error("Failed to apply change at index %lld: %s", (long long) i, error_msg);
         }
-
         AMresultFree(result);
+
+        // The core ignores a chunk it cannot parse, so check them here
+        for (size_t offset = 0; offset < len[i];) {
+            size_t size = chunk_size(src[i] + offset);
+            if (chunk_status(doc, src[i] + offset, size, error_msg) < 0) {
+                Rf_error("Failed to apply change at index %lld: %s", (long long) i, error_msg);
+            }
+            offset += size;
+        }
+    }
+}
+
+/**
+ * Check the framing of every change, stopping with an error naming the
+ * first bad one.
+ */
+static void check_changes(R_xlen_t n, const uint8_t **src, const size_t *len) {
+    for (R_xlen_t i = 0; i < n; i++) {
+        const char *fault = check_chunks(src[i], len[i]);
+        if (fault) {
+            Rf_error("Failed to apply change at index %lld: %s", (long long) i, fault);
+        }
+    }
+}
+
+/**
+ * Locate the changes in a buffer from its "offsets" attribute.
+ *
+ * @return Number of changes, or -1 if the buffer has no usable offsets
+ */
+static R_xlen_t buffer_changes(SEXP buffer, const uint8_t ***src, size_t **len) {
+    SEXP offsets = Rf_getAttrib(buffer, Rf_install("offsets"));
+    if (TYPEOF(offsets) != REALSXP) return -1;
+
+    R_xlen_t n = XLENGTH(offsets);
+    double total = (double) XLENGTH(buffer);
+    *src = (const uint8_t **) R_alloc(n > 0 ? n : 1, sizeof(uint8_t *));
+    *len = (size_t *) R_alloc(n > 0 ? n : 1, sizeof(size_t));
+    for (R_xlen_t i = 0; i < n; i++) {
+        double start = REAL(offsets)[i];
+        double end = i + 1 < n ? REAL(offsets)[i + 1] : total;
+        if (ISNAN(start) || ISNAN(end) || start < 0 || end < start || end > total) return -1;
+        (*src)[i] = RAW(buffer) + (size_t) start;
+        (*len)[i] = (size_t) (end - start);
+    }
+    return n;
+}
+
+/**
+ * Apply changes from another peer to this document.
+ *
+ * The serialized changes are passed to a single AMloadIncremental() call,
+ * which parses every chunk and integrates them together in one batch. A list
+ * of changes is concatenated first; a change buffer (from
+ * C_am_get_changes(buffer = TRUE)) is used as is. The chunk framing of each
+ * change is checked beforehand, naming the index of the first bad one.
+ *
+ * The core stops at the first chunk it cannot parse (a bad checksum or
+ * malformed columns) and still reports success for the chunks before it.
+ * Since it parses every chunk before applying any, the whole batch was
+ * taken in exactly when the last chunk was, so only that one is checked
+ * (see chunk_status()). If it is missing, or the batch fails, the changes
+ * are re-applied and checked one at a time (changes the batch already
+ * applied are skipped as duplicates), which names the offending change or,
+ * if there is none, succeeds.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param changes List of raw vectors (serialized changes), or a raw vector
+ *   of concatenated changes
+ * @return The document pointer (invisibly, for chaining)
+ */
+SEXP C_am_apply_changes(SEXP doc_ptr, SEXP changes) {
+    AMdoc *doc = get_doc(doc_ptr);
+
+    const uint8_t *data;
+    size_t total = 0;
+    R_xlen_t n_changes;
+    const uint8_t **src = NULL;
+    size_t *len = NULL;
+
+    if (TYPEOF(changes) == RAWSXP) {
+        data = RAW(changes);
+        total = (size_t) XLENGTH(changes);
+        if (total == 0) {
+            return doc_ptr;
+        }
+        n_changes = buffer_changes(changes, &src, &len);
+        if (n_changes < 0) {
+            const char *fault = check_chunks(data, total);
+            if (fault) Rf_error("Failed to apply changes: %s", fault);
+            // Without offsets, the buffer is checked as a single change
+            n_changes = 1;
+            src = (const uint8_t **) R_alloc(1, sizeof(uint8_t *));
+            len = (size_t *) R_alloc(1, sizeof(size_t));
+            src[0] = data;
+            len[0] = total;
+        } else {
+            check_changes(n_changes, src, len);
+        }
+    } else if (TYPEOF(changes) == VECSXP) {
+        n_changes = XLENGTH(changes);
+        if (n_changes == 0) {
+            return doc_ptr;
+        }
+
+        src = (const uint8_t **) R_alloc(n_changes, sizeof(uint8_t *));
+        len = (size_t *) R_alloc(n_changes, sizeof(size_t));
+        for (R_xlen_t i = 0; i < n_changes; i++) {
+            SEXP change_bytes = VECTOR_ELT(changes, i);
+            if (TYPEOF(change_bytes) != RAWSXP) {
+                Rf_error("All changes must be raw vectors (got type %d at index %lld)",
+                        TYPEOF(change_bytes), (long long) i);
+            }
+            src[i] = RAW(change_bytes);
+            len[i] = (size_t) XLENGTH(change_bytes);
+            total += len[i];
+        }
+
+        check_changes(n_changes, src, len);
+        if (n_changes == 1) {
+            apply_changes_each(doc, n_changes, src, len);
+            return doc_ptr;
+        }
+
+        uint8_t *buffer = (uint8_t *) R_alloc(total > 0 ? total : 1, 1);
+        size_t offset = 0;
+        for (R_xlen_t i = 0; i < n_changes; i++) {
+            memcpy(buffer + offset, src[i], len[i]);
+            offset += len[i];
+        }
+        data = buffer;
+    } else {
+        Rf_error("changes must be a list of raw vectors or a raw change buffer");
+    }
+
+    AMresult *result = AMloadIncremental(doc, data, total);
+    int ok = AMresultStatus(result) == AM_STATUS_OK;
+    AMresultFree(result);
+
+    if (ok) {
+        // Find the last chunk of the last non-empty change
+        R_xlen_t last = n_changes - 1;
+        while (last >= 0 && len[last] == 0) last--;
+        if (last < 0) return doc_ptr;
+        size_t offset = 0, size = chunk_size(src[last]);
+        while (offset + size < len[last]) {
+            offset += size;
+            size = chunk_size(src[last] + offset);
+        }
+        char error_msg[MAX_ERROR_MSG_SIZE + 1];
+        if (chunk_status(doc, src[last] + offset, size, error_msg) == 1) {
+            return doc_ptr;
+        }
     }
 
+    apply_changes_each(doc, n_changes, src, len);
     return doc_ptr;
 }
@@ -0,0 +1,652 @@
+#include "automerge.h"
+
+// Socket Transport ------------------------------------------------------------
+//
+// Runs the sync protocol between processes over Unix domain or TCP sockets.
+// An endpoint is either a listener (accepting any number of peers) or a
+// single outgoing connection; each connection has its own AMsyncState. As
+// for the hub, the document external pointer lives in the endpoint's
+// protected slot.
+//
+// Messages are framed as u32 little-endian length | encoded sync message.
+// All sockets are non-blocking and nothing happens in the background: each
+// call to C_am_sync_poll() waits (up to a timeout) for activity, reads and
+// applies every complete frame, generates the next message for each peer
+// and writes as much as the socket accepts, keeping the rest for later.
+//
+// As in the hub, a connection is only asked for a new message when it has
+// received something since its last one was generated or the document heads
+// have changed, so polling idle peers (including the automatic polls driven
+// by later) does not rebuild a bloom filter over the history for each.
+//
+// A peer that disconnects or sends a malformed frame is dropped; the other
+// connections are unaffected.
+
+#ifdef _WIN32
+
+SEXP C_am_sync_listen(SEXP doc_ptr, SEXP url) {
+    Rf_error("Socket sync transport is not supported on Windows");
+    return R_NilValue;
+}
+
+SEXP C_am_sync_connect(SEXP doc_ptr, SEXP url) {
+    Rf_error("Socket sync transport is not supported on Windows");
+    return R_NilValue;
+}
+
+SEXP C_am_sync_poll(SEXP endpoint_ptr, SEXP timeout) {
+    Rf_error("Socket sync transport is not supported on Windows");
+    return R_NilValue;
+}
+
+SEXP C_am_sync_close(SEXP endpoint_ptr) {
+    Rf_error("Socket sync transport is not supported on Windows");
+    return R_NilValue;
+}
+
+SEXP C_am_sync_endpoint_info(SEXP endpoint_ptr) {
+    Rf_error("Socket sync transport is not supported on Windows");
+    return R_NilValue;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#define FRAME_HEADER_SIZE 4
+#define FRAME_MAX_SIZE ((uint32_t) 1 << 30)
+#define READ_CHUNK 65536
+#define URL_MAX 1024
+#define POLL_SLICE_MS 100
+
+typedef struct {
+    int fd;
+    AMresult *result;      // Owns the sync state
+    AMsyncState *state;    // Borrowed from result
+    uint8_t *rbuf;         // Bytes received but not yet applied
+    size_t rlen;
+    size_t rcap;
+    uint8_t *wbuf;         // Frames generated but not yet sent
+    size_t wlen;
+    size_t wcap;
+    int dead;
+    int dirty;             // Received a message since last generated
+    uint64_t heads_version;    // Endpoint heads_version at last generate
+} sync_conn;
+
+typedef struct {
+    int listen_fd;         // -1 for an outgoing connection
+    char *unix_path;       // Socket file created by a Unix listener
+    sync_conn **conns;
+    size_t n_conns;
+    size_t cap_conns;
+    int closed;
+    uint8_t *heads;        // Concatenated document heads at last poll
+    size_t heads_len;
+    uint64_t heads_version;    // Incremented whenever the heads change
+} am_endpoint;
+
+static void put_u32(uint8_t *buf, uint32_t x) {
+    for (int i = 0; i < 4; i++) buf[i] = (uint8_t) (x >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) x |= (uint32_t) buf[i] << (8 * i);
+    return x;
+}
+
+// Grow a byte buffer to hold at least `need` bytes (0 on allocation failure)
+static int reserve(uint8_t **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 1;
+    size_t n = *cap ? *cap : READ_CHUNK;
+    while (n < need) n *= 2;
+    uint8_t *grown = realloc(*buf, n);
+    if (!grown) return 0;
+    *buf = grown;
+    *cap = n;
+    return 1;
+}
+
+static int set_socket_options(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return 0;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Fails harmlessly on Unix sockets
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return 1;
+}
+
+static void conn_free(sync_conn *c) {
+    if (c->fd >= 0) close(c->fd);
+    if (c->result) AMresultFree(c->result);
+    free(c->rbuf);
+    free(c->wbuf);
+    free(c);
+}
+
+// Takes ownership of fd; returns NULL (having closed it) on failure
+static sync_conn *conn_new(int fd) {
+    sync_conn *c = calloc(1, sizeof(sync_conn));
+    AMresult *result = AMsyncStateInit();
+    if (!c || !set_socket_options(fd) || AMresultStatus(result) != AM_STATUS_OK) {
+        close(fd);
+        free(c);
+        AMresultFree(result);
+        return NULL;
+    }
+    c->fd = fd;
+    c->dirty = 1;          // A new peer always gets a first message
+    c->result = result;
+    AMitemToSyncState(AMresultItem(result), &c->state);
+    return c;
+}
+
+static int endpoint_add(am_endpoint *ep, sync_conn *c) {
+    if (ep->n_conns == ep->cap_conns) {
+        size_t n = ep->cap_conns ? ep->cap_conns * 2 : 4;
+        sync_conn **conns = realloc(ep->conns, n * sizeof(sync_conn *));
+        if (!conns) return 0;
+        ep->conns = conns;
+        ep->cap_conns = n;
+    }
+    ep->conns[ep->n_conns++] = c;
+    return 1;
+}
+
+static void endpoint_close(am_endpoint *ep) {
+    if (ep->closed) return;
+    for (size_t i = 0; i < ep->n_conns; i++) conn_free(ep->conns[i]);
+    ep->n_conns = 0;
+    if (ep->listen_fd >= 0) close(ep->listen_fd);
+    ep->listen_fd = -1;
+    if (ep->unix_path) unlink(ep->unix_path);
+    ep->closed = 1;
+}
+
+static void am_endpoint_finalizer(SEXP ext_ptr) {
+    am_endpoint *ep = (am_endpoint *) R_ExternalPtrAddr(ext_ptr);
+    if (ep) {
+        endpoint_close(ep);
+        free(ep->unix_path);
+        free(ep->conns);
+        free(ep->heads);
+        free(ep);
+    }
+    R_ClearExternalPtr(ext_ptr);
+}
+
+static am_endpoint *get_endpoint(SEXP endpoint_ptr) {
+    if (TYPEOF(endpoint_ptr) != EXTPTRSXP || !Rf_inherits(endpoint_ptr, "am_sync_endpoint")) {
+        Rf_error("Expected an am_sync_endpoint object");
+    }
+    am_endpoint *ep = (am_endpoint *) R_ExternalPtrAddr(endpoint_ptr);
+    if (!ep) {
+        Rf_error("Invalid sync endpoint pointer (NULL or freed)");
+    }
+    return ep;
+}
+
+// URL Handling ----------------------------------------------------------------
+
+typedef struct {
+    int is_unix;
+    char path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+    char host[URL_MAX];
+    char port[16];
+} sync_url;
+
+static void parse_url(SEXP url, sync_url *out) {
+    if (TYPEOF(url) != STRSXP || XLENGTH(url) != 1 || STRING_ELT(url, 0) == NA_STRING) {
+        Rf_error("url must be a single character string");
+    }
+    const char *s = CHAR(STRING_ELT(url, 0));
+    memset(out, 0, sizeof(sync_url));
+
+    if (strncmp(s, "unix://", 7) == 0) {
+        const char *path = s + 7;
+        if (*path == '\0') Rf_error("url must include a socket path");
+        if (strlen(path) >= sizeof(out->path)) Rf_error("Socket path is too long");
+        out->is_unix = 1;
+        strcpy(out->path, path);
+        return;
+    }
+
+    if (strncmp(s, "tcp://", 6) != 0) {
+        Rf_error("url must start with 'unix://' or 'tcp://'");
+    }
+    const char *host = s + 6;
+    const char *host_end;
+    const char *colon;
+    if (*host == '[') {
+        host_end = strchr(host, ']');
+        if (!host_end || host_end[1] != ':') Rf_error("url must be of the form tcp://host:port");
+        colon = host_end + 1;
+        host++;
+    } else {
+        colon = strrchr(host, ':');
+        if (!colon) Rf_error("url must be of the form tcp://host:port");
+        host_end = colon;
+    }
+    size_t host_len = (size_t) (host_end - host);
+    size_t port_len = strlen(colon + 1);
+    if (host_len == 0 || host_len >= sizeof(out->host) ||
+        port_len == 0 || port_len >= sizeof(out->port)) {
+        Rf_error("url must be of the form tcp://host:port");
+    }
+    memcpy(out->host, host, host_len);
+    strcpy(out->port, colon + 1);
+}
+
+static struct addrinfo *resolve(const sync_url *u, int passive) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive) hints.ai_flags = AI_PASSIVE;
+    struct addrinfo *res = NULL;
+    int rc = getaddrinfo(u->host, u->port, &hints, &res);
+    if (rc != 0) {
+        Rf_error("Failed to resolve '%s:%s': %s", u->host, u->port, gai_strerror(rc));
+    }
+    return res;
+}
+
+static SEXP wrap_endpoint(am_endpoint *ep, SEXP doc_ptr, const char *url) {
+    SEXP ext_ptr = PROTECT(R_MakeExternalPtr(ep, R_NilValue, doc_ptr));
+    R_RegisterCFinalizer(ext_ptr, am_endpoint_finalizer);
+    Rf_setAttrib(ext_ptr, Rf_install("url"), Rf_mkString(url));
+    Rf_classgets(ext_ptr, Rf_mkString("am_sync_endpoint"));
+    UNPROTECT(1);
+    return ext_ptr;
+}
+
+static am_endpoint *endpoint_alloc(int listen_fd) {
+    am_endpoint *ep = calloc(1, sizeof(am_endpoint));
+    if (!ep) {
+        if (listen_fd >= 0) close(listen_fd);
+        Rf_error("Failed to allocate memory for sync endpoint");
+    }
+    ep->listen_fd = listen_fd;
+    return ep;
+}
+
+// Endpoints -------------------------------------------------------------------
+
+/**
+ * Listen for sync peers.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param url "unix://<path>" or "tcp://<host>:<port>" (port 0 picks a free
+ *   port)
+ * @return External pointer with class "am_sync_endpoint" and a "url"
+ *   attribute giving the bound address
+ */
+SEXP C_am_sync_listen(SEXP doc_ptr, SEXP url) {
+    get_doc(doc_ptr);
+    sync_url u;
+    parse_url(url, &u);
+    char bound[URL_MAX + 64];
+
+    int fd;
+    if (u.is_unix) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) Rf_error("Failed to create socket: %s", strerror(errno));
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, u.path);
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+            int err = errno;
+            close(fd);
+            Rf_error("Failed to bind '%s': %s", u.path, strerror(err));
+        }
+        snprintf(bound, sizeof(bound), "unix://%s", u.path);
+    } else {
+        struct addrinfo *res = resolve(&u, 1);
+        fd = socket(res->ai_family, SOCK_STREAM, 0);
+        if (fd < 0) {
+            freeaddrinfo(res);
+            Rf_error("Failed to create socket: %s", strerror(errno));
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, res->ai_addr, res->ai_addrlen) < 0) {
+            int err = errno;
+            freeaddrinfo(res);
+            close(fd);
+            Rf_error("Failed to bind '%s:%s': %s", u.host, u.port, strerror(err));
+        }
+        freeaddrinfo(res);
+
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        int port = 0;
+        if (getsockname(fd, (struct sockaddr *) &addr, &len) == 0) {
+            port = addr.ss_family == AF_INET6 ?
+                ntohs(((struct sockaddr_in6 *) &addr)->sin6_port) :
+                ntohs(((struct sockaddr_in *) &addr)->sin_port);
+        }
+        snprintf(bound, sizeof(bound), strchr(u.host, ':') ? "tcp://[%s]:%d" : "tcp://%s:%d",
+                 u.host, port);
+    }
+
+    if (listen(fd, SOMAXCONN) < 0 || !set_socket_options(fd)) {
+        int err = errno;
+        close(fd);
+        if (u.is_unix) unlink(u.path);
+        Rf_error("Failed to listen: %s", strerror(err));
+    }
+
+    am_endpoint *ep = endpoint_alloc(fd);
+    if (u.is_unix) {
+        ep->unix_path = malloc(strlen(u.path) + 1);
+        if (ep->unix_path) strcpy(ep->unix_path, u.path);
+    }
+    return wrap_endpoint(ep, doc_ptr, bound);
+}
+
+/**
+ * Connect to a listening sync peer.
+ *
+ * @param doc_ptr External pointer to am_doc
+ * @param url "unix://<path>" or "tcp://<host>:<port>"
+ * @return External pointer with class "am_sync_endpoint"
+ */
+SEXP C_am_sync_connect(SEXP doc_ptr, SEXP url) {
+    get_doc(doc_ptr);
+    sync_url u;
+    parse_url(url, &u);
+
+    int fd;
+    if (u.is_unix) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) Rf_error("Failed to create socket: %s", strerror(errno));
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, u.path);
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+            int err = errno;
+            close(fd);
+            Rf_error("Failed to connect to '%s': %s", u.path, strerror(err));
+        }
+    } else {
+        struct addrinfo *res = resolve(&u, 0);
+        fd = socket(res->ai_family, SOCK_STREAM, 0);
+        if (fd < 0) {
+            freeaddrinfo(res);
+            Rf_error("Failed to create socket: %s", strerror(errno));
+        }
+        if (connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+            int err = errno;
+            freeaddrinfo(res);
+            close(fd);
+            Rf_error("Failed to connect to '%s:%s': %s", u.host, u.port, strerror(err));
+        }
+        freeaddrinfo(res);
+    }
+
+    sync_conn *c = conn_new(fd);
+    if (!c) Rf_error("Failed to set up sync connection");
+    am_endpoint *ep = calloc(1, sizeof(am_endpoint));
+    if (!ep || !endpoint_add(ep, c)) {
+        free(ep);
+        conn_free(c);
+        Rf_error("Failed to allocate memory for sync endpoint");
+    }
+    ep->listen_fd = -1;
+    return wrap_endpoint(ep, doc_ptr, CHAR(STRING_ELT(url, 0)));
+}
+
+// Polling ---------------------------------------------------------------------
+
+static void accept_peers(am_endpoint *ep) {
+    for (;;) {
+        int fd = accept(ep->listen_fd, NULL, NULL);
+        if (fd < 0) return;  // EAGAIN: no more pending connections
+        sync_conn *c = conn_new(fd);
+        if (!c) continue;
+        if (!endpoint_add(ep, c)) {
+            conn_free(c);
+            return;
+        }
+    }
+}
+
+// Read everything available; marks the connection dead on EOF or error
+static void conn_read(sync_conn *c) {
+    for (;;) {
+        if (!reserve(&c->rbuf, &c->rcap, c->rlen + READ_CHUNK)) {
+            c->dead = 1;
+            return;
+        }
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, READ_CHUNK, 0);
+        if (n > 0) {
+            c->rlen += (size_t) n;
+        } else if (n == 0) {
+            c->dead = 1;
+            return;
+        } else {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) c->dead = 1;
+            return;
+        }
+    }
+}
+
+// Apply every complete frame; returns the number applied, or -1 if the peer
+// sent something that is not a valid sync message
+static int conn_apply(sync_conn *c, AMdoc *doc) {
+    int applied = 0;
+    size_t offset = 0;
+    while (c->rlen - offset >= FRAME_HEADER_SIZE) {
+        uint32_t len = get_u32(c->rbuf + offset);
+        if (len > FRAME_MAX_SIZE) return -1;
+        if (c->rlen - offset - FRAME_HEADER_SIZE < len) break;
+
+        AMresult *decode_result = AMsyncMessageDecode(c->rbuf + offset + FRAME_HEADER_SIZE, len);
+        if (AMresultStatus(decode_result) != AM_STATUS_OK) {
+            AMresultFree(decode_result);
+            return -1;
+        }
+        AMsyncMessage const *msg = NULL;
+        AMitemToSyncMessage(AMresultItem(decode_result), &msg);
+        AMresult *result = AMreceiveSyncMessage(doc, c->state, msg);
+        AMresultFree(decode_result);
+        int ok = AMresultStatus(result) == AM_STATUS_OK;
+        AMresultFree(result);
+        if (!ok) return -1;
+
+        offset += FRAME_HEADER_SIZE + len;
+        applied++;
+        c->dirty = 1;
+    }
+    if (offset > 0) {
+        memmove(c->rbuf, c->rbuf + offset, c->rlen - offset);
+        c->rlen -= offset;
+    }
+    return applied;
+}
+
+static void conn_generate(sync_conn *c, AMdoc *doc) {
+    AMresult *result = AMgenerateSyncMessage(doc, c->state);
+    CHECK_RESULT(result, AM_VAL_TYPE_VOID);
+    AMitem *item = AMresultItem(result);
+    if (!item || AMitemValType(item) != AM_VAL_TYPE_SYNC_MESSAGE) {
+        AMresultFree(result);
+        return;
+    }
+
+    AMsyncMessage const *msg = NULL;
+    AMitemToSyncMessage(item, &msg);
+    AMresult *encode_result = AMsyncMessageEncode(msg);
+    AMresultFree(result);
+    CHECK_RESULT(encode_result, AM_VAL_TYPE_BYTES);
+
+    AMbyteSpan bytes;
+    AMitemToBytes(AMresultItem(encode_result), &bytes);
+    if (bytes.count > FRAME_MAX_SIZE ||
+        !reserve(&c->wbuf, &c->wcap, c->wlen + FRAME_HEADER_SIZE + bytes.count)) {
+        AMresultFree(encode_result);
+        c->dead = 1;
+        return;
+    }
+    put_u32(c->wbuf + c->wlen, (uint32_t) bytes.count);
+    memcpy(c->wbuf + c->wlen + FRAME_HEADER_SIZE, bytes.src, bytes.count);
+    c->wlen += FRAME_HEADER_SIZE + bytes.count;
+    AMresultFree(encode_result);
+}
+
+static void conn_flush(sync_conn *c) {
+    size_t sent = 0;
+    while (sent < c->wlen) {
+        ssize_t n = send(c->fd, c->wbuf + sent, c->wlen - sent, SEND_FLAGS);
+        if (n > 0) {
+            sent += (size_t) n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) c->dead = 1;
+            break;
+        }
+    }
+    if (sent > 0) {
+        memmove(c->wbuf, c->wbuf + sent, c->wlen - sent);
+        c->wlen -= sent;
+    }
+}
+
+/**
+ * Wait for activity and exchange sync messages with every peer.
+ *
+ * @param endpoint_ptr External pointer to am_endpoint
+ * @param timeout Numeric scalar: seconds to wait for activity (0 returns
+ *   immediately)
+ * @return Integer scalar: number of messages applied to the document
+ */
+SEXP C_am_sync_poll(SEXP endpoint_ptr, SEXP timeout) {
+    am_endpoint *ep = get_endpoint(endpoint_ptr);
+    if (ep->closed) {
+        Rf_error("Sync endpoint is closed");
+    }
+    AMdoc *doc = get_doc(R_ExternalPtrProtected(endpoint_ptr));
+    double secs = Rf_asReal(timeout);
+    if (ISNAN(secs) || secs < 0) {
+        Rf_error("timeout must be a single non-negative number");
+    }
+
+    size_t n_fds = ep->n_conns + (ep->listen_fd >= 0);
+    struct pollfd *fds = (struct pollfd *) R_alloc(n_fds > 0 ? n_fds : 1, sizeof(struct pollfd));
+    size_t k = 0;
+    if (ep->listen_fd >= 0) {
+        fds[k].fd = ep->listen_fd;
+        fds[k++].events = POLLIN;
+    }
+    for (size_t i = 0; i < ep->n_conns; i++) {
+        fds[k].fd = ep->conns[i]->fd;
+        fds[k++].events = POLLIN | (ep->conns[i]->wlen > 0 ? POLLOUT : 0);
+    }
+    // Wait in short slices so that a long timeout can be interrupted
+    int timeout_ms = secs > 86400 ? 86400000 : (int) (secs * 1000);
+    while (n_fds > 0) {
+        int slice = timeout_ms < POLL_SLICE_MS ? timeout_ms : POLL_SLICE_MS;
+        int ready = poll(fds, n_fds, slice);
+        if (ready < 0 && errno != EINTR) {
+            Rf_error("Failed to poll sync endpoint: %s", strerror(errno));
+        }
+        if (ready > 0) break;
+        timeout_ms -= slice;
+        if (timeout_ms <= 0) break;
+        R_CheckUserInterrupt();
+    }
+
+    if (ep->listen_fd >= 0) accept_peers(ep);
+
+    int applied = 0;
+    for (size_t i = 0; i < ep->n_conns; i++) {
+        sync_conn *c = ep->conns[i];
+        conn_read(c);
+        int n = conn_apply(c, doc);
+        if (n < 0) {
+            c->dead = 1;
+        } else {
+            applied += n;
+        }
+    }
+
+    if (am_heads_changed(doc, &ep->heads, &ep->heads_len)) ep->heads_version++;
+    for (size_t i = 0; i < ep->n_conns; i++) {
+        sync_conn *c = ep->conns[i];
+        if (c->dead) continue;
+        if (c->dirty || c->heads_version != ep->heads_version) {
+            conn_generate(c, doc);
+            c->dirty = 0;
+            c->heads_version = ep->heads_version;
+        }
+        conn_flush(c);
+    }
+
+    size_t live = 0;
+    for (size_t i = 0; i < ep->n_conns; i++) {
+        if (ep->conns[i]->dead) {
+            conn_free(ep->conns[i]);
+        } else {
+            ep->conns[live++] = ep->conns[i];
+        }
+    }
+    ep->n_conns = live;
+
+    return Rf_ScalarInteger(applied);
+}
+
+/**
+ * Close an endpoint and every connection it holds.
+ *
+ * @param endpoint_ptr External pointer to am_endpoint
+ * @return NULL
+ */
+SEXP C_am_sync_close(SEXP endpoint_ptr) {
+    endpoint_close(get_endpoint(endpoint_ptr));
+    return R_NilValue;
+}
+
+/**
+ * Endpoint status.
+ *
+ * @param endpoint_ptr External pointer to am_endpoint
+ * @return Named list: open, listening, peers, pending_bytes
+ */
+SEXP C_am_sync_endpoint_info(SEXP endpoint_ptr) {
+    am_endpoint *ep = get_endpoint(endpoint_ptr);
+    double pending = 0;
+    for (size_t i = 0; i < ep->n_conns; i++) pending += (double) ep->conns[i]->wlen;
+
+    const char *names[] = {"open", "listening", "peers", "pending_bytes", ""};
+    SEXP out = PROTECT(Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(out, 0, Rf_ScalarLogical(!ep->closed));
+    SET_VECTOR_ELT(out, 1, Rf_ScalarLogical(ep->listen_fd >= 0));
+    SET_VECTOR_ELT(out, 2, Rf_ScalarInteger((int) ep->n_conns));
+    SET_VECTOR_ELT(out, 3, Rf_ScalarReal(pending));
+    UNPROTECT(1);
+    return out;
+}
+
+#endif